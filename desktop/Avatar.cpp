@@ -12,7 +12,7 @@ Copyright 2020 Michael Zahniser
 namespace {
 	// List of sprites to use for facing in any given direction.
 	vector<pair<Point, int>> facings;
-	// Movement speed, in pixels per frame.
+	// Movement speed, in pixels per simulation step.
 	int speed = 50;
 	// The initial facing direction, unless it is changed by a face command.
 	const int DEFAULT_FACING = 180;
@@ -34,11 +34,11 @@ namespace {
 	// index for facing straight towards the bottom of the screen.)
 	int Facing(Point v = Point(0, 1))
 	{
-		int bestDot = numeric_limits<int>::min();
+		Point::Product bestDot = numeric_limits<Point::Product>::min();
 		int best = 0;
 		for(const pair<Point, int> &it : facings)
 		{
-			int dot = v.Dot(it.first);
+			Point::Product dot = v.Dot(it.first);
 			if(dot > bestDot)
 			{
 				bestDot = dot;
@@ -56,10 +56,21 @@ void Avatar::Load(Data &data)
 {
 	while(data.Next() && data.Size())
 	{
-		if(data.Tag() == "sprite" && data.Size() >= 2)
-			facings.emplace_back(Vector(data[2]), data[1]);
-		else if(data.Tag() == "speed" && data.Size() >= 2)
-			speed = data[1];
+		// Every field has at least one value.
+		if(data.Size() < 2)
+			continue;
+		
+		switch(data.Key())
+		{
+			case Data::SPRITE:
+				facings.emplace_back(Vector(data[2]), data[1]);
+				break;
+			case Data::SPEED:
+				speed = data[1];
+				break;
+			default:
+				break;
+		}
 	}
 }
 
@@ -0,0 +1,385 @@
+/* Blitter.cpp
+Copyright 2020 Michael Zahniser
+*/
+
+#include "Blitter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// SSE2 is always available on x86-64. The AVX2 kernel is compiled separately
+// for that instruction set, and only used if the CPU turns out to support it.
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BLITTER_AVX2
+#endif
+
+using namespace std;
+
+namespace {
+	// Supported images have the alpha in the top byte of each pixel.
+	const uint32_t ALPHA = 0xFF000000;
+	// Runs of opaque pixels shorter than this are blended instead of getting
+	// a span of their own, and so are gaps this short between two spans. The
+	// blending kernels handle fully opaque and transparent pixels correctly, so
+	// this just avoids having lots of tiny spans.
+	const int MIN_SPAN = 8;
+	
+	// Get a pointer to the given row of a surface.
+	uint32_t *Row(const SDL_Surface *surface, int y)
+	{
+		uint8_t *bytes = reinterpret_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+		return reinterpret_cast<uint32_t *>(bytes);
+	}
+	
+	// Blend one pixel the same way SDL's alpha blitter for 32-bit surfaces
+	// does. Each channel is (s * a >> 8) + (d * (255 - a) >> 8), except that
+	// for the alpha channel the source is multiplied by 255 instead of a. Fully
+	// transparent pixels leave the target alone, and opaque ones are copied.
+	inline uint32_t Blend(uint32_t s, uint32_t d)
+	{
+		uint32_t a = s >> 24;
+		if(!a)
+			return d;
+		if(a == 255)
+			return s;
+		
+		uint32_t result = 0;
+		for(int shift = 0; shift < 32; shift += 8)
+		{
+			uint32_t sc = (s >> shift) & 0xFF;
+			uint32_t dc = (d >> shift) & 0xFF;
+			uint32_t weight = (shift == 24 ? 255 : a);
+			result |= (((sc * weight) >> 8) + ((dc * (255 - a)) >> 8)) << shift;
+		}
+		return result;
+	}
+	
+	void BlendScalar(const uint32_t *in, uint32_t *out, int count)
+	{
+		for(int i = 0; i < count; ++i)
+			out[i] = Blend(in[i], out[i]);
+	}
+	
+#ifdef __SSE2__
+	// Blend two pixels that have been unpacked to 16 bits per channel.
+	inline __m128i Mix(__m128i s, __m128i d)
+	{
+		// Copy each pixel's alpha into all four of its channels.
+		__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+		__m128i sWeight = _mm_or_si128(a, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+		__m128i dWeight = _mm_sub_epi16(_mm_set1_epi16(255), a);
+		s = _mm_srli_epi16(_mm_mullo_epi16(s, sWeight), 8);
+		d = _mm_srli_epi16(_mm_mullo_epi16(d, dWeight), 8);
+		return _mm_add_epi16(s, d);
+	}
+	
+	// Blend four pixels at a time.
+	void BlendSSE2(const uint32_t *in, uint32_t *out, int count)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i opaque = _mm_set1_epi32(255);
+		int i = 0;
+		for( ; i + 4 <= count; i += 4)
+		{
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(out + i));
+			__m128i lo = Mix(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+			__m128i hi = Mix(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+			__m128i mixed = _mm_packus_epi16(lo, hi);
+			
+			// Transparent pixels keep the old value, and opaque ones are copied.
+			__m128i alpha = _mm_srli_epi32(s, 24);
+			__m128i isClear = _mm_cmpeq_epi32(alpha, zero);
+			__m128i isSolid = _mm_cmpeq_epi32(alpha, opaque);
+			__m128i result = _mm_or_si128(_mm_and_si128(isClear, d), _mm_and_si128(isSolid, s));
+			result = _mm_or_si128(result, _mm_andnot_si128(_mm_or_si128(isClear, isSolid), mixed));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), result);
+		}
+		BlendScalar(in + i, out + i, count - i);
+	}
+#endif
+	
+#ifdef BLITTER_AVX2
+	// The same as Mix(), but for four pixels at once.
+	__attribute__((target("avx2")))
+	inline __m256i Mix256(__m256i s, __m256i d)
+	{
+		__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+		__m256i sWeight = _mm256_or_si256(a, _mm256_set_epi16(
+			255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0));
+		__m256i dWeight = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+		s = _mm256_srli_epi16(_mm256_mullo_epi16(s, sWeight), 8);
+		d = _mm256_srli_epi16(_mm256_mullo_epi16(d, dWeight), 8);
+		return _mm256_add_epi16(s, d);
+	}
+	
+	// Blend eight pixels at a time.
+	__attribute__((target("avx2")))
+	void BlendAVX2(const uint32_t *in, uint32_t *out, int count)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i opaque = _mm256_set1_epi32(255);
+		int i = 0;
+		for( ; i + 8 <= count; i += 8)
+		{
+			__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+			__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(out + i));
+			// Unpacking and packing both work within each 128-bit half, so
+			// the pixels end up back in their original order.
+			__m256i lo = Mix256(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+			__m256i hi = Mix256(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+			__m256i mixed = _mm256_packus_epi16(lo, hi);
+			
+			__m256i alpha = _mm256_srli_epi32(s, 24);
+			__m256i isClear = _mm256_cmpeq_epi32(alpha, zero);
+			__m256i isSolid = _mm256_cmpeq_epi32(alpha, opaque);
+			__m256i result = _mm256_or_si256(_mm256_and_si256(isClear, d), _mm256_and_si256(isSolid, s));
+			result = _mm256_or_si256(result, _mm256_andnot_si256(_mm256_or_si256(isClear, isSolid), mixed));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), result);
+		}
+		BlendScalar(in + i, out + i, count - i);
+	}
+#endif
+	
+	// Check if the given kernel can be used on this CPU.
+	bool IsAvailable(Blitter::Kernel kernel)
+	{
+#ifdef BLITTER_AVX2
+		if(kernel == Blitter::AVX2)
+			return SDL_HasAVX2();
+#endif
+#ifdef __SSE2__
+		if(kernel == Blitter::SSE2)
+			return SDL_HasSSE2();
+#endif
+		return (kernel == Blitter::SCALAR);
+	}
+	
+	// Find the fastest kernel that this CPU supports.
+	Blitter::Kernel Fastest()
+	{
+		if(IsAvailable(Blitter::AVX2))
+			return Blitter::AVX2;
+		if(IsAvailable(Blitter::SSE2))
+			return Blitter::SSE2;
+		return Blitter::SCALAR;
+	}
+	
+	// Get the blending function for the given kernel.
+	typedef void (*BlendFunction)(const uint32_t *, uint32_t *, int);
+	BlendFunction Function(Blitter::Kernel kernel)
+	{
+#ifdef BLITTER_AVX2
+		if(kernel == Blitter::AVX2)
+			return BlendAVX2;
+#endif
+#ifdef __SSE2__
+		if(kernel == Blitter::SSE2)
+			return BlendSSE2;
+#endif
+		return BlendScalar;
+	}
+	
+	Blitter::Kernel current = Fastest();
+	BlendFunction blend = Function(current);
+	
+	// Blend the given pixels as if they were all the given color, keeping
+	// only their alpha. They are recolored in small batches on the stack.
+	void BlendTinted(const uint32_t *in, uint32_t *out, int count, uint32_t color)
+	{
+		const int BATCH = 64;
+		uint32_t batch[BATCH];
+		while(count > 0)
+		{
+			int size = min(count, BATCH);
+			for(int i = 0; i < size; ++i)
+				batch[i] = (in[i] & ALPHA) | color;
+			blend(batch, out, size);
+			in += size;
+			out += size;
+			count -= size;
+		}
+	}
+}
+
+
+
+// Check whether images in the given format can be drawn onto surfaces in
+// the given format using a Blitter.
+bool Blitter::IsSupported(const SDL_PixelFormat *source, const SDL_PixelFormat *target)
+{
+	return (source->BytesPerPixel == 4 && target->BytesPerPixel == 4 && source->Amask == ALPHA
+		&& source->Rmask == target->Rmask && source->Gmask == target->Gmask && source->Bmask == target->Bmask);
+}
+
+
+
+// Choose which blending kernel to use. By default, the fastest one that
+// this CPU supports is used.
+bool Blitter::SetKernel(Kernel kernel)
+{
+	if(!IsAvailable(kernel))
+		return false;
+	
+	current = kernel;
+	blend = Function(kernel);
+	return true;
+}
+
+
+
+Blitter::Kernel Blitter::GetKernel()
+{
+	return current;
+}
+
+
+
+const char *Blitter::KernelName(Kernel kernel)
+{
+	static const char *NAMES[] = {"scalar", "SSE2", "AVX2"};
+	return NAMES[kernel];
+}
+
+
+
+// Build the mask for the given rectangle of the given surface.
+Blitter::Blitter(const SDL_Surface *surface, const Rect &rect)
+{
+	if(!surface || !surface->pixels || surface->format->BytesPerPixel != 4 || surface->format->Amask != ALPHA)
+		return;
+	if(rect.x < 0 || rect.y < 0 || rect.w <= 0 || rect.h <= 0
+			|| rect.x + rect.w > surface->w || rect.y + rect.h > surface->h)
+		return;
+	
+	width = rect.w;
+	height = rect.h;
+	// Find the runs of transparent, opaque, and partly transparent pixels in
+	// each row.
+	enum {CLEAR, SOLID, BLEND};
+	vector<int> starts;
+	vector<int> kinds;
+	for(int y = 0; y < height; ++y)
+	{
+		rows.push_back(spans.size());
+		const uint32_t *row = Row(surface, rect.y + y) + rect.x;
+		starts.clear();
+		kinds.clear();
+		for(int x = 0; x < width; ++x)
+		{
+			uint32_t alpha = row[x] >> 24;
+			int kind = (!alpha ? CLEAR : alpha == 255 ? SOLID : BLEND);
+			if(kinds.empty() || kinds.back() != kind)
+			{
+				starts.push_back(x);
+				kinds.push_back(kind);
+			}
+		}
+		starts.push_back(width);
+		
+		// Short opaque runs, and short gaps between other runs, are blended.
+		for(size_t i = 0; i < kinds.size(); ++i)
+		{
+			bool isShort = (starts[i + 1] - starts[i] < MIN_SPAN);
+			bool isInside = (i && i + 1 < kinds.size());
+			if(isShort && (kinds[i] == SOLID || isInside))
+				kinds[i] = BLEND;
+		}
+		// Merge neighboring runs of the same kind, and drop transparent ones.
+		for(size_t i = 0; i < kinds.size(); ++i)
+		{
+			if(kinds[i] == CLEAR)
+				continue;
+			
+			bool isOpaque = (kinds[i] == SOLID);
+			int x = starts[i];
+			int end = starts[i + 1];
+			if(static_cast<int>(spans.size()) > rows.back() && spans.back().isOpaque == isOpaque
+					&& spans.back().x + spans.back().width == x)
+				spans.back().width = end - spans.back().x;
+			else
+				spans.push_back(Span{x, end - x, isOpaque});
+		}
+	}
+	rows.push_back(spans.size());
+}
+
+
+
+// Check if this mask was built successfully.
+bool Blitter::IsValid() const
+{
+	return !rows.empty();
+}
+
+
+
+// Draw the given rectangle of the source image, with its top left corner
+// at the given point.
+void Blitter::Draw(const SDL_Surface *source, const SDL_Rect &from, SDL_Surface *target, Point corner) const
+{
+	DrawSpans(source, from, target, corner, false, 0);
+}
+
+
+
+// Draw the same way, but with every pixel in the given color, keeping
+// only the source's alpha.
+void Blitter::Draw(const SDL_Surface *source, const SDL_Rect &from, SDL_Surface *target, Point corner, uint32_t color) const
+{
+	DrawSpans(source, from, target, corner, true, color & ~ALPHA);
+}
+
+
+
+// Draw the given rectangle of the source image. If the image is tinted,
+// every pixel is drawn in the given color instead of its own.
+void Blitter::DrawSpans(const SDL_Surface *source, const SDL_Rect &from, SDL_Surface *target, Point corner, bool isTinted, uint32_t color) const
+{
+	// Clip the drawing to the target's clipping rectangle.
+	const SDL_Rect &clip = target->clip_rect;
+	int left = max(corner.X(), clip.x);
+	int top = max(corner.Y(), clip.y);
+	int right = min(corner.X() + width, clip.x + clip.w);
+	int bottom = min(corner.Y() + height, clip.y + clip.h);
+	if(left >= right || top >= bottom)
+		return;
+	
+	bool mustLock = SDL_MUSTLOCK(target);
+	if(mustLock && SDL_LockSurface(target))
+		return;
+	
+	// The source pixel for target column x is at column x + shift.
+	int shift = from.x - corner.X();
+	for(int y = top; y < bottom; ++y)
+	{
+		int row = y - corner.Y();
+		const uint32_t *in = Row(source, from.y + row);
+		uint32_t *out = Row(target, y);
+		for(int i = rows[row]; i < rows[row + 1]; ++i)
+		{
+			const Span &span = spans[i];
+			int begin = max(left, corner.X() + span.x);
+			int end = min(right, corner.X() + span.x + span.width);
+			if(begin >= end)
+				continue;
+			
+			if(isTinted && span.isOpaque)
+				fill(out + begin, out + end, ALPHA | color);
+			else if(isTinted)
+				BlendTinted(in + begin + shift, out + begin, end - begin, color);
+			else if(span.isOpaque)
+				memcpy(out + begin, in + begin + shift, (end - begin) * sizeof(uint32_t));
+			else
+				blend(in + begin + shift, out + begin, end - begin);
+		}
+	}
+	
+	if(mustLock)
+		SDL_UnlockSurface(target);
+}
@@ -0,0 +1,93 @@
+/* Blitter.h
+Copyright 2020 Michael Zahniser
+*/
+
+#ifndef BLITTER_H_
+#define BLITTER_H_
+
+#include "Point.h"
+#include "Rect.h"
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+
+
+// A Blitter is a precomputed "span mask" for one rectangle of an image with an
+// alpha channel, e.g. one sprite frame or one glyph. For each row, it lists the
+// runs of fully opaque pixels, which are simply copied, and the runs that need
+// blending. Fully transparent pixels are skipped entirely. This only supports
+// 32-bit images with the alpha in the top byte, drawn onto 32-bit surfaces with
+// the same color channels, which is what Sprite::Prepare() and Font::Prepare()
+// produce for most displays. Blending is done with SSE2 or AVX2 if the CPU has
+// them, and the result is exactly the same as from SDL's own alpha blitter.
+class Blitter {
+public:
+	// Blending kernels, from slowest to fastest.
+	enum Kernel {SCALAR, SSE2, AVX2};
+	
+	// Check whether images in the given format can be drawn onto surfaces in
+	// the given format using a Blitter.
+	static bool IsSupported(const SDL_PixelFormat *source, const SDL_PixelFormat *target);
+	// Choose which blending kernel to use. By default, the fastest one that
+	// this CPU supports is used. Returns false if the given kernel is not
+	// supported, in which case the current one is kept.
+	static bool SetKernel(Kernel kernel);
+	static Kernel GetKernel();
+	static const char *KernelName(Kernel kernel);
+	
+	
+public:
+	Blitter() = default;
+	// Build the mask for the given rectangle of the given surface. If the
+	// surface does not have a supported format, or the rectangle is not
+	// entirely inside it, the mask will not be valid.
+	Blitter(const SDL_Surface *surface, const Rect &rect);
+	
+	// Check if this mask was built successfully.
+	bool IsValid() const;
+	// Draw the given rectangle of the source image, with its top left corner
+	// at the given point. The rectangle must be the same size as the one this
+	// mask was built from, and must have the same transparency. The source is
+	// drawn with ordinary alpha blending, and is clipped the same way that
+	// SDL_BlitSurface() would clip it.
+	void Draw(const SDL_Surface *source, const SDL_Rect &from, SDL_Surface *target, Point corner) const;
+	// Draw the same way, but with every pixel in the given color, keeping
+	// only the source's alpha. The color is a pixel value in the source's
+	// format, and its alpha bits are ignored. For a white image this gives
+	// what SDL's color modulation is meant to, but with the same blending as
+	// for an image that was drawn in that color to begin with.
+	void Draw(const SDL_Surface *source, const SDL_Rect &from, SDL_Surface *target, Point corner, uint32_t color) const;
+	
+	
+private:
+	// Draw the given rectangle of the source image. If the image is tinted,
+	// every pixel is drawn in the given color instead of its own.
+	void DrawSpans(const SDL_Surface *source, const SDL_Rect &from, SDL_Surface *target, Point corner, bool isTinted, uint32_t color) const;
+	
+	
+private:
+	// A run of pixels within one row.
+	class Span {
+	public:
+		int x;
+		int width;
+		bool isOpaque;
+	};
+	
+	
+private:
+	int width = 0;
+	int height = 0;
+	// The spans in row y are spans[rows[y]] through spans[rows[y + 1] - 1].
+	vector<int> rows;
+	vector<Span> spans;
+};
+
+
+
+#endif
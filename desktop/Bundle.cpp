@@ -0,0 +1,375 @@
+/* Bundle.cpp
+Copyright 2020 Michael Zahniser
+*/
+
+#include "Bundle.h"
+
+#include <SDL2/SDL_image.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+	// A bundle starts with this, then the version number and the number of
+	// files. Everything is in the byte order of the machine that built it, so
+	// a bundle must be rebuilt when the game is copied to another kind of
+	// machine, or when the format changes and the version is incremented.
+	const char MAGIC[8] = {'W', 'H', 'I', 'M', 'S', 'Y', 'B', '\0'};
+	const uint32_t VERSION = 2;
+	const size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(uint32_t);
+	// Next is an index with the offset, size, modification time, kind, and
+	// path length of each file, followed by the path itself.
+	const size_t INDEX_SIZE = 3 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+	// The contents of each file start at a multiple of this, which is the size
+	// of a cache line.
+	const size_t ALIGN = 64;
+	// An image starts with its width, height, pitch, pixel format, and bits
+	// per pixel, padded to a whole cache line so that its pixels are aligned
+	// the same way.
+	const size_t IMAGE_HEADER_SIZE = ALIGN;
+	enum Kind : uint32_t {RAW, IMAGE};
+	
+	// The bundle that is open, if any.
+	class Entry {
+	public:
+		Kind kind;
+		string_view contents;
+	};
+	map<string, Entry> entries;
+	// The directory that the paths in the bundle are relative to.
+	string root;
+#ifdef _WIN32
+	string buffer;
+#else
+	char *mapped = nullptr;
+	size_t mappedSize = 0;
+#endif
+	
+	// Extract the directory path from the given file path.
+	string DirPath(const string &path)
+	{
+		return path.substr(0, path.rfind('/') + 1);
+	}
+	
+	// Get the time the given file was last modified, or -1 if it does not
+	// exist.
+	int64_t Modified(const string &path)
+	{
+		struct stat info;
+		return stat(path.c_str(), &info) ? -1 : static_cast<int64_t>(info.st_mtime);
+	}
+	
+	// Read a value from the bundle, advancing past it. Returns false if that
+	// would read past the end.
+	template <class Type>
+	bool ReadValue(string_view &in, Type &value)
+	{
+		if(in.size() < sizeof(value))
+			return false;
+		memcpy(&value, in.data(), sizeof(value));
+		in.remove_prefix(sizeof(value));
+		return true;
+	}
+	
+	// Append a value to the bundle.
+	template <class Type>
+	void WriteValue(string &out, const Type &value)
+	{
+		out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+	
+	// Pad the bundle to a multiple of the alignment.
+	size_t Align(size_t size)
+	{
+		return (size + ALIGN - 1) & ~(ALIGN - 1);
+	}
+	
+	// Read the index of the given bundle. Returns false if it is not a bundle
+	// from this version of the engine, or if it is damaged.
+	bool ReadIndex(string_view bundle)
+	{
+		string_view in = bundle;
+		char magic[sizeof(MAGIC)];
+		uint32_t version = 0;
+		uint32_t count = 0;
+		if(!ReadValue(in, magic) || memcmp(magic, MAGIC, sizeof(MAGIC)) || !ReadValue(in, version) || version != VERSION
+				|| !ReadValue(in, count))
+			return false;
+		
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			int64_t modified = 0;
+			uint32_t kind = RAW;
+			uint32_t length = 0;
+			if(!ReadValue(in, offset) || !ReadValue(in, size) || !ReadValue(in, modified) || !ReadValue(in, kind) || !ReadValue(in, length)
+					|| in.size() < length || offset > bundle.size() || size > bundle.size() - offset)
+				return false;
+			string path(in.substr(0, length));
+			in.remove_prefix(length);
+			
+			// If any file has changed since the bundle was built, the whole
+			// bundle is out of date. A file that is not there at all is fine,
+			// because a released game only needs to include the bundle.
+			int64_t current = Modified(root + path);
+			if(current != -1 && current != modified)
+			{
+				cerr << "Not using the bundle, because " << path << " has changed since it was built." << endl;
+				return false;
+			}
+			entries[path] = Entry{static_cast<Kind>(kind), bundle.substr(offset, size)};
+		}
+		return true;
+	}
+}
+
+
+
+// Add the given file, unchanged. Returns false if it can't be read.
+bool Bundle::Builder::AddFile(const string &path)
+{
+	ifstream in(path, ios::binary);
+	if(!in)
+		return false;
+	
+	entries.push_back(Entry{RAW, path, Modified(path), string()});
+	entries.back().contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	return true;
+}
+
+
+
+// Add the given image, decoded to 32 bits per pixel, which is the format the
+// sprites and fonts would convert it to anyway. Returns false if it can't be
+// loaded.
+bool Bundle::Builder::AddImage(const string &path)
+{
+	SDL_Surface *image = IMG_Load(path.c_str());
+	if(image && image->format->BytesPerPixel != 4)
+	{
+		SDL_Surface *converted = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+		SDL_FreeSurface(image);
+		image = converted;
+	}
+	if(!image)
+		return false;
+	
+	entries.push_back(Entry{IMAGE, path, Modified(path), string()});
+	string &out = entries.back().contents;
+	uint32_t pitch = image->w * 4;
+	uint32_t header[] = {static_cast<uint32_t>(image->w), static_cast<uint32_t>(image->h), pitch,
+		image->format->format, image->format->BitsPerPixel};
+	WriteValue(out, header);
+	out.resize(IMAGE_HEADER_SIZE);
+	
+	SDL_LockSurface(image);
+	for(int y = 0; y < image->h; ++y)
+		out.append(reinterpret_cast<const char *>(image->pixels) + y * image->pitch, pitch);
+	SDL_UnlockSurface(image);
+	SDL_FreeSurface(image);
+	return true;
+}
+
+
+
+// Check if the given file has already been added.
+bool Bundle::Builder::Has(const string &path) const
+{
+	for(const Entry &entry : entries)
+		if(entry.path == path)
+			return true;
+	return false;
+}
+
+
+
+// Get the number of files that have been added.
+size_t Bundle::Builder::Size() const
+{
+	return entries.size();
+}
+
+
+
+// Write the bundle for the given data file. Returns false if it could not be
+// written.
+bool Bundle::Builder::Write(const string &dataPath) const
+{
+	// The paths are stored relative to the data file's directory, so that the
+	// game can be moved somewhere else once the bundle has been built.
+	string directory = DirPath(dataPath);
+	auto relative = [&directory](const string &path)
+	{
+		return path.compare(0, directory.size(), directory) ? path : path.substr(directory.size());
+	};
+	
+	// Figure out where each file will go, after the header and the index.
+	size_t offset = HEADER_SIZE;
+	for(const Entry &entry : entries)
+		offset += INDEX_SIZE + relative(entry.path).size();
+	
+	string out(MAGIC, sizeof(MAGIC));
+	WriteValue(out, VERSION);
+	WriteValue(out, static_cast<uint32_t>(entries.size()));
+	for(const Entry &entry : entries)
+	{
+		offset = Align(offset);
+		string path = relative(entry.path);
+		WriteValue(out, static_cast<uint64_t>(offset));
+		WriteValue(out, static_cast<uint64_t>(entry.contents.size()));
+		WriteValue(out, entry.modified);
+		WriteValue(out, entry.kind);
+		WriteValue(out, static_cast<uint32_t>(path.size()));
+		out += path;
+		offset += entry.contents.size();
+	}
+	for(const Entry &entry : entries)
+	{
+		out.resize(Align(out.size()));
+		out += entry.contents;
+	}
+	
+	ofstream file(Path(dataPath), ios::binary);
+	return file.write(out.data(), out.size()) && file.flush();
+}
+
+
+
+// Get the path of the bundle that is compiled from the given data file, which
+// is that file with its extension changed to ".bundle".
+string Bundle::Path(const string &dataPath)
+{
+	size_t dot = dataPath.rfind('.');
+	if(dot == string::npos || dot < DirPath(dataPath).size())
+		dot = dataPath.size();
+	return dataPath.substr(0, dot) + ".bundle";
+}
+
+
+
+// Open the bundle for the given data file, if there is one and it was compiled
+// by this version of the engine from the current data. Returns false if the
+// text data and images must be loaded instead.
+bool Bundle::Open(const string &dataPath)
+{
+	Close();
+	root = DirPath(dataPath);
+	string path = Path(dataPath);
+	
+#ifdef _WIN32
+	ifstream in(path, ios::binary);
+	buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	string_view bundle = buffer;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	
+	// The whole bundle is mapped at once. The mapping is private, so if
+	// anything modifies an image loaded from it, only that page is copied.
+	struct stat info;
+	size_t fileSize = (fstat(fd, &info) ? 0 : info.st_size);
+	void *data = (fileSize ? mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED);
+	close(fd);
+	if(data == MAP_FAILED)
+		return false;
+	mapped = static_cast<char *>(data);
+	mappedSize = fileSize;
+	// Almost all of it will be used right away.
+	madvise(data, fileSize, MADV_WILLNEED);
+	string_view bundle(mapped, mappedSize);
+#endif
+	
+	if(!ReadIndex(bundle))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+
+
+// Close the bundle. Any images loaded from it must be freed first.
+void Bundle::Close()
+{
+	entries.clear();
+#ifdef _WIN32
+	buffer.clear();
+	buffer.shrink_to_fit();
+#else
+	if(mapped)
+		munmap(mapped, mappedSize);
+	mapped = nullptr;
+	mappedSize = 0;
+#endif
+}
+
+
+
+bool Bundle::IsOpen()
+{
+	return !entries.empty();
+}
+
+
+
+// Get the paths of all the files in the bundle, as they would be named if they
+// were loaded from the data file's directory instead.
+vector<string> Bundle::Files()
+{
+	vector<string> files;
+	for(const auto &it : entries)
+		files.push_back(root + it.first);
+	return files;
+}
+
+
+
+// Get the contents of the given file, if it is in the bundle. Otherwise, the
+// returned view's data() is null. The contents stay in memory until the bundle
+// is closed.
+string_view Bundle::Find(const string &path)
+{
+	if(entries.empty() || path.compare(0, root.size(), root))
+		return string_view();
+	
+	auto it = entries.find(path.substr(root.size()));
+	return (it == entries.end() || it->second.kind != RAW) ? string_view() : it->second.contents;
+}
+
+
+
+// Load the given image from the bundle, or from its file if it is not in the
+// bundle. The pixels of an image in the bundle are not copied.
+SDL_Surface *Bundle::LoadImage(const string &path)
+{
+	if(entries.empty() || path.compare(0, root.size(), root))
+		return IMG_Load(path.c_str());
+	auto it = entries.find(path.substr(root.size()));
+	if(it == entries.end() || it->second.kind != IMAGE)
+		return IMG_Load(path.c_str());
+	
+	string_view in = it->second.contents;
+	uint32_t header[5];
+	if(!ReadValue(in, header) || in.size() < IMAGE_HEADER_SIZE - sizeof(header)
+			|| static_cast<uint64_t>(header[1]) * header[2] > in.size() - (IMAGE_HEADER_SIZE - sizeof(header)))
+		return IMG_Load(path.c_str());
+	
+	// The mapping is writable, even though the view into it is not.
+	char *pixels = const_cast<char *>(it->second.contents.data()) + IMAGE_HEADER_SIZE;
+	return SDL_CreateRGBSurfaceWithFormatFrom(pixels, header[0], header[1], header[4], header[2], header[3]);
+}
@@ -0,0 +1,84 @@
+/* Bundle.h
+Copyright 2020 Michael Zahniser
+*/
+
+#ifndef BUNDLE_H_
+#define BUNDLE_H_
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+
+
+// A scenario compiled into a single file, so that the game can start up by
+// mapping that one file into memory instead of reading every data file and
+// decoding every image. The bundle holds the text of each data file, the
+// decoded pixels of each image, and the cached kerning of each font. Each is
+// stored under its path relative to the main data file, and remembers when its
+// source file was last modified: if any of them has changed since the bundle
+// was built, the bundle is not used at all.
+class Bundle {
+public:
+	// Collects the files for a bundle, and writes it out.
+	class Builder {
+	public:
+		// Add the given file, unchanged. Returns false if it can't be read.
+		bool AddFile(const string &path);
+		// Add the given image, decoded to 32 bits per pixel, which is the
+		// format the sprites and fonts would convert it to anyway. Returns
+		// false if it can't be loaded.
+		bool AddImage(const string &path);
+		// Check if the given file has already been added.
+		bool Has(const string &path) const;
+		// Get the number of files that have been added.
+		size_t Size() const;
+		
+		// Write the bundle for the given data file. Returns false if it could
+		// not be written.
+		bool Write(const string &dataPath) const;
+		
+	private:
+		class Entry {
+		public:
+			uint32_t kind;
+			string path;
+			int64_t modified;
+			string contents;
+		};
+		vector<Entry> entries;
+	};
+	
+	
+public:
+	// Get the path of the bundle that is compiled from the given data file,
+	// which is that file with its extension changed to ".bundle".
+	static string Path(const string &dataPath);
+	// Open the bundle for the given data file, if there is one and it was
+	// compiled by this version of the engine from the current data. Returns
+	// false if the text data and images must be loaded instead.
+	static bool Open(const string &dataPath);
+	// Close the bundle. Any images loaded from it must be freed first.
+	static void Close();
+	static bool IsOpen();
+	// Get the paths of all the files in the bundle, as they would be named
+	// if they were loaded from the data file's directory instead.
+	static vector<string> Files();
+	
+	// Get the contents of the given file, if it is in the bundle. Otherwise,
+	// the returned view's data() is null. The contents stay in memory until
+	// the bundle is closed.
+	static string_view Find(const string &path);
+	// Load the given image from the bundle, or from its file if it is not in
+	// the bundle. The pixels of an image in the bundle are not copied.
+	static SDL_Surface *LoadImage(const string &path);
+};
+
+
+
+#endif
@@ -0,0 +1,66 @@
+/* Clock.cpp
+Copyright 2020 Michael Zahniser
+*/
+
+#include "Clock.h"
+
+using namespace std;
+
+namespace {
+	// Maximum number of ticks to catch up on at once.
+	const int MAX_TICKS = 5;
+}
+
+
+
+// Create a clock with the given number of ticks per second.
+Clock::Clock(int rate)
+	: rate(rate)
+{
+}
+
+
+
+// Start counting ticks from the given time, e.g. after the clock has not
+// been checked for a while and the time in between should be skipped.
+void Clock::Reset(uint32_t now)
+{
+	start = now;
+	ticks = 0;
+	fraction = 0.;
+}
+
+
+
+// Advance the clock to the given time, and return how many ticks have
+// passed since the last call. If the clock falls too far behind, e.g.
+// because the program was suspended, the extra ticks are dropped.
+int Clock::Advance(uint32_t now)
+{
+	if(rate <= 0)
+		return 0;
+	
+	// Count ticks from the start time rather than adding up the intervals, so
+	// that rounding errors do not accumulate.
+	uint64_t elapsed = static_cast<uint64_t>(now - start) * rate;
+	uint32_t total = elapsed / 1000;
+	fraction = (elapsed % 1000) * .001;
+	
+	int count = total - ticks;
+	ticks = total;
+	if(count > MAX_TICKS)
+	{
+		count = MAX_TICKS;
+		Reset(now);
+	}
+	return count;
+}
+
+
+
+// Get how far the clock is between the last tick and the next one, from 0
+// (just ticked) to 1 (about to tick).
+double Clock::Fraction() const
+{
+	return fraction;
+}
@@ -0,0 +1,47 @@
+/* Clock.h
+Copyright 2020 Michael Zahniser
+*/
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <cstdint>
+
+using namespace std;
+
+
+
+// A Clock divides real time into ticks of a fixed length, so that something
+// (such as the simulation, or the sprite animations) can be stepped forward at
+// a constant rate no matter how often the screen is actually redrawn. Times
+// are in milliseconds, as returned by SDL_GetTicks().
+class Clock {
+public:
+	Clock() = default;
+	// Create a clock with the given number of ticks per second.
+	explicit Clock(int rate);
+	
+	// Start counting ticks from the given time, e.g. after the clock has not
+	// been checked for a while and the time in between should be skipped.
+	void Reset(uint32_t now);
+	// Advance the clock to the given time, and return how many ticks have
+	// passed since the last call. If the clock falls too far behind, e.g.
+	// because the program was suspended, the extra ticks are dropped.
+	int Advance(uint32_t now);
+	// Get how far the clock is between the last tick and the next one, from 0
+	// (just ticked) to 1 (about to tick).
+	double Fraction() const;
+	
+	
+private:
+	int rate = 0;
+	// The time that the clock started counting from, how many ticks it has
+	// counted since then, and how far it is into the next one.
+	uint32_t start = 0;
+	uint32_t ticks = 0;
+	double fraction = 0.;
+};
+
+
+
+#endif
@@ -0,0 +1,548 @@
+/* Compositor.cpp
+Copyright 2020 Michael Zahniser
+*/
+
+#include "Compositor.h"
+
+#include "Blitter.h"
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Everything about a surface that affects how it is drawn, or drawn onto.
+	// If any of this changes, a thread's view of the surface must be rebuilt.
+	class Source {
+	public:
+		Source() = default;
+		explicit Source(SDL_Surface *surface);
+		
+		bool operator==(const Source &other) const;
+		bool operator!=(const Source &other) const;
+		
+		SDL_Surface *surface = nullptr;
+		void *pixels = nullptr;
+		int w = 0;
+		int h = 0;
+		int pitch = 0;
+		int bits = 0;
+		uint32_t format = 0;
+		SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+		bool hasKey = false;
+		uint32_t key = 0;
+		uint8_t alpha = 255;
+		uint8_t r = 255;
+		uint8_t g = 255;
+		uint8_t b = 255;
+	};
+	
+	// A recorded fill or blit. If there is no source surface, it is a fill.
+	// Blits with a span mask draw straight from the source's pixels, so they
+	// don't need a view of the source.
+	class Command {
+	public:
+		Source source;
+		const Blitter *mask = nullptr;
+		SDL_Rect from;
+		SDL_Rect to;
+		SDL_Rect clip;
+		// The fill color, or the color of a tinted blit with a span mask.
+		uint32_t color = 0;
+		bool isTinted = false;
+	};
+	
+	// Each thread draws onto its own band of the target surface, and has its
+	// own views of the source surfaces. (SDL caches information about the
+	// last surface that a surface was blitted onto inside the source surface,
+	// so two threads can't blit from the same SDL_Surface at the same time.)
+	class Worker {
+	public:
+		~Worker();
+		
+		// Draw the recorded commands onto this worker's band.
+		void Draw();
+		// Get this thread's view of the given source surface.
+		SDL_Surface *Alias(const Source &source);
+		// Discard this thread's band and views.
+		void Clear();
+		
+		SDL_Surface *band = nullptr;
+		int top = 0;
+		map<SDL_Surface *, pair<Source, SDL_Surface *>> aliases;
+		thread runner;
+	};
+	
+	// State shared between the main thread and the workers.
+	class Pool {
+	public:
+		~Pool();
+		
+		// Stop and join all the worker threads.
+		void Stop();
+		// Loop run by each worker thread, starting after the given generation
+		// of commands has been finished.
+		void Work(Worker *worker, int finished);
+		
+		mutex lock;
+		condition_variable start;
+		condition_variable done;
+		int generation = 0;
+		int remaining = 0;
+		bool quit = false;
+		
+		vector<unique_ptr<Worker>> workers;
+		
+		// The surface being recorded, and its state when the bands were made.
+		SDL_Surface *target = nullptr;
+		Source targetState;
+		vector<Command> commands;
+		// If any command can't be split up between threads, the whole frame
+		// is drawn on the main thread instead.
+		bool isSerial = false;
+	};
+	Pool pool;
+	
+	// Number of frames that have been begun.
+	uint64_t frameCount = 0;
+	// Number of fills and blits, and the number of pixels they covered.
+	uint64_t commandCount = 0;
+	uint64_t pixelCount = 0;
+	
+	// Count a fill or blit of the given rectangle onto the given surface.
+	void Count(const SDL_Surface *surface, SDL_Rect rect)
+	{
+		++commandCount;
+		if(SDL_IntersectRect(&rect, &surface->clip_rect, &rect))
+			pixelCount += rect.w * rect.h;
+	}
+	
+	// Check if the given surface can be shared between threads by giving each
+	// thread its own view of the same pixels.
+	bool CanAlias(const SDL_Surface *surface)
+	{
+		return (surface->pixels && !surface->format->palette && !(surface->flags & SDL_RLEACCEL));
+	}
+}
+
+
+
+// Set the number of threads to use. If this is 0 (the default), the
+// compositor is disabled.
+void Compositor::SetThreads(int count)
+{
+	pool.Stop();
+	// Each worker starts out waiting for the generation after this one, even
+	// if End() begins it before the worker's thread is running.
+	int generation = 0;
+	{
+		lock_guard<mutex> guard(pool.lock);
+		pool.quit = false;
+		generation = pool.generation;
+	}
+	for(int i = 0; i < count; ++i)
+	{
+		pool.workers.emplace_back(new Worker);
+		Worker *worker = pool.workers.back().get();
+		worker->runner = thread(&Pool::Work, &pool, worker, generation);
+	}
+}
+
+
+
+int Compositor::Threads()
+{
+	return pool.workers.size();
+}
+
+
+
+bool Compositor::IsEnabled()
+{
+	return !pool.workers.empty();
+}
+
+
+
+// Begin recording the drawing commands for the given surface.
+void Compositor::Begin(SDL_Surface *target)
+{
+	++frameCount;
+	if(!IsEnabled())
+		return;
+	
+	pool.target = target;
+	pool.commands.clear();
+	pool.isSerial = !CanAlias(target);
+}
+
+
+
+// Draw everything that has been recorded since Begin().
+void Compositor::End()
+{
+	if(!pool.target)
+		return;
+	
+	SDL_Surface *target = pool.target;
+	pool.target = nullptr;
+	if(pool.commands.empty())
+		return;
+	
+	if(pool.isSerial)
+	{
+		// Draw everything directly, then restore the clipping rectangle.
+		SDL_Rect clip = target->clip_rect;
+		for(Command &command : pool.commands)
+		{
+			SDL_SetClipRect(target, &command.clip);
+			if(command.mask)
+				command.mask->Draw(command.source.surface, command.from, target, Point(command.to.x, command.to.y));
+			else if(command.source.surface)
+				SDL_BlitSurface(command.source.surface, &command.from, target, &command.to);
+			else
+				SDL_FillRect(target, &command.to, command.color);
+		}
+		SDL_SetClipRect(target, &clip);
+		pool.commands.clear();
+		return;
+	}
+	
+	// If the target has changed (e.g. because the window was resized), the
+	// bands must be recreated. Views of the sources are tied to the bands, so
+	// discard them too.
+	Source state(target);
+	if(state != pool.targetState)
+	{
+		pool.targetState = state;
+		int count = pool.workers.size();
+		for(int i = 0; i < count; ++i)
+		{
+			Worker &worker = *pool.workers[i];
+			worker.Clear();
+			worker.top = (target->h * i) / count;
+			int height = (target->h * (i + 1)) / count - worker.top;
+			if(height <= 0)
+				continue;
+			
+			uint8_t *pixels = reinterpret_cast<uint8_t *>(target->pixels) + worker.top * target->pitch;
+			worker.band = SDL_CreateRGBSurfaceWithFormatFrom(
+				pixels, target->w, height, state.bits, target->pitch, state.format);
+		}
+	}
+	
+	// Wake up the workers, and wait for all of them to finish.
+	unique_lock<mutex> lock(pool.lock);
+	pool.remaining = pool.workers.size();
+	++pool.generation;
+	pool.start.notify_all();
+	pool.done.wait(lock, []() { return !pool.remaining; });
+	pool.commands.clear();
+}
+
+
+
+// Get the number of times that Begin() has been called. A surface that was
+// drawn from since the most recent Begin() must not be freed until End().
+uint64_t Compositor::Frames()
+{
+	return frameCount;
+}
+
+
+
+// Drop the threads' views of the given surface, because it is about to be
+// freed. Anything that creates and frees surfaces while the game runs must
+// call this first, or the views build up.
+void Compositor::Forget(SDL_Surface *surface)
+{
+	// The workers only use their views inside End(), which the main thread
+	// waits for, so they can be changed here without locking.
+	for(unique_ptr<Worker> &worker : pool.workers)
+	{
+		auto it = worker->aliases.find(surface);
+		if(it == worker->aliases.end())
+			continue;
+		
+		if(it->second.second)
+			SDL_FreeSurface(it->second.second);
+		worker->aliases.erase(it);
+	}
+}
+
+
+
+// Replacements for SDL_FillRect() and SDL_BlitSurface(). The target's
+// current clipping rectangle is recorded along with each command.
+void Compositor::Fill(SDL_Surface *surface, const SDL_Rect *rect, uint32_t color)
+{
+	Count(surface, rect ? *rect : surface->clip_rect);
+	if(!pool.target || surface != pool.target)
+	{
+		SDL_FillRect(surface, rect, color);
+		return;
+	}
+	
+	pool.commands.emplace_back();
+	Command &command = pool.commands.back();
+	command.clip = surface->clip_rect;
+	command.to = rect ? *rect : surface->clip_rect;
+	command.color = color;
+}
+
+
+
+void Compositor::Blit(SDL_Surface *source, const SDL_Rect *from, SDL_Surface *surface, const SDL_Rect *to)
+{
+	if(source)
+		Count(surface, SDL_Rect{to ? to->x : 0, to ? to->y : 0,
+			from ? from->w : source->w, from ? from->h : source->h});
+	if(!pool.target || surface != pool.target)
+	{
+		SDL_Rect rect = to ? *to : SDL_Rect{0, 0, 0, 0};
+		SDL_BlitSurface(source, from, surface, &rect);
+		return;
+	}
+	if(!source)
+		return;
+	
+	pool.commands.emplace_back();
+	Command &command = pool.commands.back();
+	command.source = Source(source);
+	command.from = from ? *from : SDL_Rect{0, 0, source->w, source->h};
+	command.to = to ? *to : SDL_Rect{0, 0, 0, 0};
+	command.clip = surface->clip_rect;
+	pool.isSerial |= !CanAlias(source);
+}
+
+
+
+// Blit using the given span mask for the source rectangle, if it is valid
+// and supports the source and target formats. Otherwise, use SDL.
+void Compositor::Blit(const Blitter &mask, SDL_Surface *source, const SDL_Rect *from, SDL_Surface *surface, const SDL_Rect *to)
+{
+	if(!source || !from || !to || !source->pixels || !mask.IsValid()
+			|| !Blitter::IsSupported(source->format, surface->format))
+	{
+		Blit(source, from, surface, to);
+		return;
+	}
+	Count(surface, SDL_Rect{to->x, to->y, from->w, from->h});
+	if(!pool.target || surface != pool.target)
+	{
+		mask.Draw(source, *from, surface, Point(to->x, to->y));
+		return;
+	}
+	
+	pool.commands.emplace_back();
+	Command &command = pool.commands.back();
+	command.source.surface = source;
+	command.mask = &mask;
+	command.from = *from;
+	command.to = *to;
+	command.clip = surface->clip_rect;
+}
+
+
+
+// Blit a white image in the given color, e.g. a glyph.
+void Compositor::Blit(const Blitter &mask, SDL_Surface *source, const SDL_Rect *from, SDL_Surface *surface, const SDL_Rect *to, const Color &color)
+{
+	if(!source || !from || !to || !source->pixels || !mask.IsValid()
+			|| !Blitter::IsSupported(source->format, surface->format))
+	{
+		if(source)
+			SDL_SetSurfaceColorMod(source, color.r, color.g, color.b);
+		Blit(source, from, surface, to);
+		return;
+	}
+	Count(surface, SDL_Rect{to->x, to->y, from->w, from->h});
+	if(!pool.target || surface != pool.target)
+	{
+		mask.Draw(source, *from, surface, Point(to->x, to->y), color(source));
+		return;
+	}
+	
+	pool.commands.emplace_back();
+	Command &command = pool.commands.back();
+	command.source.surface = source;
+	command.mask = &mask;
+	command.from = *from;
+	command.to = *to;
+	command.clip = surface->clip_rect;
+	command.color = color(source);
+	command.isTinted = true;
+}
+
+
+
+// Count the fills and blits since the last ResetCounts(), and how many
+// target pixels they covered after clipping. This works whether or not
+// the compositor is enabled.
+void Compositor::ResetCounts()
+{
+	commandCount = 0;
+	pixelCount = 0;
+}
+
+
+
+uint64_t Compositor::Commands()
+{
+	return commandCount;
+}
+
+
+
+uint64_t Compositor::Pixels()
+{
+	return pixelCount;
+}
+
+
+
+namespace {
+	Source::Source(SDL_Surface *surface)
+		: surface(surface), pixels(surface->pixels), w(surface->w), h(surface->h),
+		pitch(surface->pitch), bits(surface->format->BitsPerPixel), format(surface->format->format)
+	{
+		SDL_GetSurfaceBlendMode(surface, &blend);
+		hasKey = !SDL_GetColorKey(surface, &key);
+		SDL_GetSurfaceAlphaMod(surface, &alpha);
+		SDL_GetSurfaceColorMod(surface, &r, &g, &b);
+	}
+	
+	bool Source::operator==(const Source &other) const
+	{
+		return (surface == other.surface && pixels == other.pixels && w == other.w && h == other.h
+			&& pitch == other.pitch && format == other.format && blend == other.blend
+			&& hasKey == other.hasKey && (!hasKey || key == other.key)
+			&& alpha == other.alpha && r == other.r && g == other.g && b == other.b);
+	}
+	
+	bool Source::operator!=(const Source &other) const
+	{
+		return !(*this == other);
+	}
+	
+	Worker::~Worker()
+	{
+		Clear();
+	}
+	
+	// Draw the recorded commands onto this worker's band.
+	void Worker::Draw()
+	{
+		if(!band)
+			return;
+		
+		for(const Command &command : pool.commands)
+		{
+			// Shift the clipping rectangle into band coordinates. If it does
+			// not overlap this band, there is nothing to draw.
+			SDL_Rect clip = command.clip;
+			clip.y -= top;
+			if(!SDL_SetClipRect(band, &clip))
+				continue;
+			
+			SDL_Rect to = command.to;
+			to.y -= top;
+			if(command.mask && command.isTinted)
+				command.mask->Draw(command.source.surface, command.from, band, Point(to.x, to.y), command.color);
+			else if(command.mask)
+				command.mask->Draw(command.source.surface, command.from, band, Point(to.x, to.y));
+			else if(!command.source.surface)
+				SDL_FillRect(band, &to, command.color);
+			else
+			{
+				SDL_Surface *alias = Alias(command.source);
+				SDL_Rect from = command.from;
+				if(alias)
+					SDL_BlitSurface(alias, &from, band, &to);
+			}
+		}
+	}
+	
+	// Get this thread's view of the given source surface.
+	SDL_Surface *Worker::Alias(const Source &source)
+	{
+		pair<Source, SDL_Surface *> &it = aliases[source.surface];
+		if(it.second && it.first == source)
+			return it.second;
+		
+		if(it.second)
+			SDL_FreeSurface(it.second);
+		it.first = source;
+		it.second = SDL_CreateRGBSurfaceWithFormatFrom(
+			source.pixels, source.w, source.h, source.bits, source.pitch, source.format);
+		if(it.second)
+		{
+			SDL_SetSurfaceBlendMode(it.second, source.blend);
+			if(source.hasKey)
+				SDL_SetColorKey(it.second, SDL_TRUE, source.key);
+			SDL_SetSurfaceAlphaMod(it.second, source.alpha);
+			SDL_SetSurfaceColorMod(it.second, source.r, source.g, source.b);
+		}
+		return it.second;
+	}
+	
+	// Discard this thread's band and views.
+	void Worker::Clear()
+	{
+		for(auto &it : aliases)
+			if(it.second.second)
+				SDL_FreeSurface(it.second.second);
+		aliases.clear();
+		if(band)
+			SDL_FreeSurface(band);
+		band = nullptr;
+	}
+	
+	Pool::~Pool()
+	{
+		Stop();
+	}
+	
+	// Stop and join all the worker threads.
+	void Pool::Stop()
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			quit = true;
+		}
+		start.notify_all();
+		for(unique_ptr<Worker> &worker : workers)
+			if(worker->runner.joinable())
+				worker->runner.join();
+		workers.clear();
+		targetState = Source();
+	}
+	
+	// Loop run by each worker thread, starting after the given generation
+	// of commands has been finished.
+	void Pool::Work(Worker *worker, int finished)
+	{
+		while(true)
+		{
+			{
+				unique_lock<mutex> guard(lock);
+				start.wait(guard, [&]() { return quit || generation != finished; });
+				if(quit)
+					return;
+				finished = generation;
+			}
+			
+			worker->Draw();
+			
+			lock_guard<mutex> guard(lock);
+			if(!--remaining)
+				done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,72 @@
+/* Compositor.h
+Copyright 2020 Michael Zahniser
+*/
+
+#ifndef COMPOSITOR_H_
+#define COMPOSITOR_H_
+
+#include "Color.h"
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+
+class Blitter;
+
+using namespace std;
+
+
+
+// The compositor optionally spreads the work of drawing a frame across several
+// threads. Between Begin() and End(), fills and blits onto the target surface
+// are recorded instead of being done right away. End() then splits the target
+// into one horizontal band per thread, and each thread draws every recorded
+// command that touches its band, in order, using SDL's own blitters. The result
+// is the same as drawing everything on one thread.
+// Fills and blits onto any other surface, or while the compositor is disabled,
+// are passed straight through to SDL.
+// SDL decodes RLE surfaces in place when it blits them, so the threads can't
+// share them. Surfaces must not use RLE while the compositor is enabled.
+class Compositor {
+public:
+	// Set the number of threads to use. If this is 0 (the default), the
+	// compositor is disabled.
+	static void SetThreads(int count);
+	static int Threads();
+	static bool IsEnabled();
+	
+	// Begin recording the drawing commands for the given surface.
+	static void Begin(SDL_Surface *target);
+	// Draw everything that has been recorded since Begin().
+	static void End();
+	// Get the number of times that Begin() has been called. A surface that was
+	// drawn from since the most recent Begin() must not be freed until End().
+	static uint64_t Frames();
+	// Drop the threads' views of the given surface, because it is about to be
+	// freed. Anything that creates and frees surfaces while the game runs
+	// must call this first, or the views build up.
+	static void Forget(SDL_Surface *surface);
+	
+	// Replacements for SDL_FillRect() and SDL_BlitSurface(). The target's
+	// current clipping rectangle is recorded along with each command.
+	static void Fill(SDL_Surface *surface, const SDL_Rect *rect, uint32_t color);
+	static void Blit(SDL_Surface *source, const SDL_Rect *from, SDL_Surface *surface, const SDL_Rect *to);
+	// Blit using the given span mask for the source rectangle, if it is valid
+	// and supports the source and target formats. Otherwise, use SDL.
+	static void Blit(const Blitter &mask, SDL_Surface *source, const SDL_Rect *from, SDL_Surface *surface, const SDL_Rect *to);
+	// Blit a white image in the given color, e.g. a glyph. With a span mask
+	// this is exactly the same as blitting a copy of the image that was drawn
+	// in that color. Otherwise, SDL's color modulation is used.
+	static void Blit(const Blitter &mask, SDL_Surface *source, const SDL_Rect *from, SDL_Surface *surface, const SDL_Rect *to, const Color &color);
+	
+	// Count the fills and blits since the last ResetCounts(), and how many
+	// target pixels they covered after clipping. This works whether or not
+	// the compositor is enabled.
+	static void ResetCounts();
+	static uint64_t Commands();
+	static uint64_t Pixels();
+};
+
+
+
+#endif
@@ -4,9 +4,19 @@ Copyright 2020 Michael Zahniser
 
 #include "Data.h"
 
+#include "Bundle.h"
+
+#include <algorithm>
 #include <cctype>
-#include <cstdlib>
 #include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -20,6 +30,145 @@ namespace {
 		// both conditions simplify down to this:
 		return path.substr(0, path.rfind('/') + 1);
 	}
+	
+	// Check if the given character is whitespace. Characters above 127 never
+	// are, even if char is signed.
+	bool IsSpace(char c)
+	{
+		return isspace(static_cast<unsigned char>(c));
+	}
+	
+	// Files smaller than this are read into a buffer instead of being mapped
+	// into memory, because for them, setting up the mapping takes longer.
+	const size_t MAP_SIZE = 1 << 16;
+	
+	// The name of each keyword, in the same order as the Keyword enum.
+	constexpr string_view NAMES[] = {"active", "add", "animation", "ask",
+		"avatar", "background", "baseline", "bold", "bounds", "cache", "color",
+		"compositor", "dialog", "else", "enter", "exit", "face", "family", "fps",
+		"fullscreen", "game", "goto", "icon", "if", "index", "init", "interaction",
+		"italic", "layer", "mask", "menu", "normal", "offset", "option", "position",
+		"remove", "room", "say", "scene", "set", "sheet", "size", "speed", "sprite",
+		"stats", "style", "visible", "window"};
+	static_assert(sizeof(NAMES) / sizeof(NAMES[0]) + 1 == Data::KEYWORDS, "Every keyword needs a name.");
+	
+	// Check that the names are sorted, so that they can be binary searched.
+	constexpr bool IsSorted()
+	{
+		for(size_t i = 1; i < sizeof(NAMES) / sizeof(NAMES[0]); ++i)
+			if(!(NAMES[i - 1] < NAMES[i]))
+				return false;
+		return true;
+	}
+	static_assert(IsSorted(), "The keywords must be in alphabetical order.");
+	
+	// Convert the given token to an integer, the same way atoi() would. The
+	// token is not null terminated, so atoi() itself can't be used.
+	int ToInt(string_view token)
+	{
+		size_t i = (!token.empty() && (token[0] == '-' || token[0] == '+'));
+		int value = 0;
+		for( ; i < token.size() && token[i] >= '0' && token[i] <= '9'; ++i)
+			value = value * 10 + (token[i] - '0');
+		return (!token.empty() && token[0] == '-') ? -value : value;
+	}
+}
+
+
+
+// The contents of a file, mapped into memory if possible. Small files, and all
+// files where memory mapping is not available, are read into a buffer instead.
+// Files in the scenario bundle, if there is one, are already in memory.
+class Data::File {
+public:
+	explicit File(const string &path);
+	File(const File &) = delete;
+	File &operator=(const File &) = delete;
+	~File();
+	
+	// Get the file's contents. This is empty if it could not be read.
+	string_view Contents() const;
+	
+private:
+	string_view bundled;
+	string buffer;
+#ifndef _WIN32
+	const char *data = nullptr;
+	size_t size = 0;
+#endif
+};
+
+
+
+Data::File::File(const string &path)
+	: bundled(Bundle::Find(path))
+{
+	if(bundled.data())
+		return;
+	
+#ifdef _WIN32
+	ifstream in(path, ios::binary);
+	buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return;
+	
+	// Map large files into memory, and read small ones, or any file that can't
+	// be mapped, into the buffer.
+	struct stat info;
+	size_t fileSize = (fstat(fd, &info) ? 0 : info.st_size);
+	if(fileSize >= MAP_SIZE)
+	{
+		void *mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mapped != MAP_FAILED)
+		{
+			data = static_cast<const char *>(mapped);
+			size = fileSize;
+			// The file is read once, from start to end.
+			madvise(mapped, size, MADV_SEQUENTIAL);
+		}
+	}
+	if(!data && fileSize)
+	{
+		buffer.resize(fileSize);
+		size_t done = 0;
+		while(done < fileSize)
+		{
+			ssize_t count = read(fd, &buffer[done], fileSize - done);
+			if(count <= 0)
+				break;
+			done += count;
+		}
+		buffer.resize(done);
+	}
+	// The mapping stays valid after the file is closed.
+	close(fd);
+#endif
+}
+
+
+
+Data::File::~File()
+{
+#ifndef _WIN32
+	if(data)
+		munmap(const_cast<char *>(data), size);
+#endif
+}
+
+
+
+// Get the file's contents. This is empty if it could not be read.
+string_view Data::File::Contents() const
+{
+	if(bundled.data())
+		return bundled;
+#ifndef _WIN32
+	if(data)
+		return string_view(data, size);
+#endif
+	return buffer;
 }
 
 
@@ -43,10 +192,15 @@ Data::Data(const string &path)
 
 
 
+// Make a Data object from the given lines. It keeps its own copy of them,
+// so they do not need to outlive it, and its views stay valid even if the
+// original list is changed.
 Data::Data(const vector<string> &lines)
+	: copy(make_shared<const vector<string>>(lines))
 {
-	it = lines.begin();
-	end = lines.end();
+	this->lines.assign(copy->begin(), copy->end());
+	it = this->lines.begin();
+	end = this->lines.end();
 	Tokenize();
 }
 
@@ -84,7 +238,7 @@ bool Data::operator!() const
 // the given output stream.
 void Data::Save(ostream &out) const
 {
-	for(vector<string>::const_iterator rit = it; rit != end; ++rit)
+	for(vector<string_view>::const_iterator rit = it; rit != end; ++rit)
 		out << *rit << '\n';
 }
 
@@ -108,7 +262,7 @@ size_t Data::Size() const
 
 
 // Get the entire line as one string, including leading and trailing space.
-const string &Data::Line() const
+string_view Data::Line() const
 {
 	return *it;
 }
@@ -118,10 +272,7 @@ const string &Data::Line() const
 // Get the "tag," i.e. the first word of the line.
 string Data::Tag() const
 {
-	if(tokens.empty())
-		return string();
-	
-	return (*this)[0];
+	return string(TagView());
 }
 
 
@@ -130,9 +281,28 @@ string Data::Tag() const
 // types this will be a single field, and for others it may contain multiple
 // fields separated by whitespace. Trailing spaces are trimmed out.
 string Data::Value(size_t index) const
+{
+	return string(ValueView(index));
+}
+
+
+
+// Get the tag or value the same way, but without copying it. The view is
+// valid for as long as this Data object is.
+string_view Data::TagView() const
+{
+	if(tokens.empty())
+		return string_view();
+	
+	return it->substr(tokens[0], tokens[1] - tokens[0]);
+}
+
+
+
+string_view Data::ValueView(size_t index) const
 {
 	if(tokens.size() < 2 * (index + 1))
-		return string();
+		return string_view();
 	
 	size_t pos = tokens[2 * index];
 	return it->substr(pos, tokens.back() - pos);
@@ -140,6 +310,14 @@ string Data::Value(size_t index) const
 
 
 
+// Get the tag as a keyword, or OTHER if it is not one of them.
+Data::Keyword Data::Key() const
+{
+	return keyword;
+}
+
+
+
 // Get the current line's indent, in characters. All characters count the
 // same, so a tab is the same as a single space, not multiple spaces.
 int Data::Indent() const
@@ -149,15 +327,19 @@ int Data::Indent() const
 
 
 
-// Get the given whitespace-separated argument.
+// Get the given whitespace-separated argument. If the line does not have
+// that many arguments, it is empty.
 Data::Arg Data::operator[](size_t index) const
 {
+	if(tokens.size() < 2 * (index + 1))
+		return Arg(string_view(), 0, 0);
+	
 	return Arg(*it, tokens[index * 2], tokens[index * 2 + 1]);
 }
 
 
 
-Data::Arg::Arg(const string &line, size_t start, size_t end)
+Data::Arg::Arg(string_view line, size_t start, size_t end)
 	: line(line), start(start), end(end)
 {
 }
@@ -167,7 +349,7 @@ Data::Arg::Arg(const string &line, size_t start, size_t end)
 // Allow an argument to be typecast to any of the following types.
 Data::Arg::operator string() const
 {
-	return line.substr(start, end - start);
+	return string(line.substr(start, end - start));
 }
 
 
@@ -181,14 +363,14 @@ Data::Arg::operator bool() const
 
 Data::Arg::operator int() const
 {
-	return atoi(line.c_str() + start);
+	return ToInt(line.substr(start, end - start));
 }
 
 
 
 Data::Arg::operator size_t() const
 {
-	return atoi(line.c_str() + start);
+	return ToInt(line.substr(start, end - start));
 }
 
 
@@ -196,10 +378,9 @@ Data::Arg::operator size_t() const
 Data::Arg::operator Point() const
 {
 	// Look for a comma.
-	const char *str = line.c_str();
 	for(size_t i = start; i < end; ++i)
 		if(line[i] == ',')
-			return Point(atoi(str + start), atoi(str + i + 1));
+			return Point(ToInt(line.substr(start, i - start)), ToInt(line.substr(i + 1, end - i - 1)));
 	
 	return Point();
 }
@@ -224,13 +405,20 @@ void Data::Load(const string &path)
 	string directory = DirPath(path);
 	directories.emplace_back(lines.size(), directory);
 	
-	ifstream in(path);
-	string line;
-	while(getline(in, line))
+	// The lines are views into the file, so it must be kept until this Data
+	// object is destroyed.
+	files.push_back(make_shared<const File>(path));
+	string_view contents = files.back()->Contents();
+	while(!contents.empty())
 	{
+		// Split off the next line, without its newline.
+		size_t length = min(contents.find('\n'), contents.size());
+		string_view line = contents.substr(0, length);
+		contents.remove_prefix(min(length + 1, contents.size()));
+		
 		// Find the first non-whitespace character.
 		size_t i = 0;
-		while(i != line.size() && isspace(line[i]))
+		while(i != line.size() && IsSpace(line[i]))
 			++i;
 		if(i != line.size())
 		{
@@ -238,12 +426,13 @@ void Data::Load(const string &path)
 			// If the line is a comment, skip it:
 			if(line[i] == '#')
 				continue;
-			static const string INCLUDE = "include";
-			if(!line.compare(i, i + INCLUDE.size(), INCLUDE) && isspace(line[i + INCLUDE.size()]))
+			static const string_view INCLUDE = "include";
+			if(!line.compare(i, i + INCLUDE.size(), INCLUDE) && line.size() > i + INCLUDE.size()
+					&& IsSpace(line[i + INCLUDE.size()]))
 			{
 				// Find the start of the second token.
 				i += INCLUDE.size() + 1;
-				while(i != line.size() && isspace(line[i]))
+				while(i != line.size() && IsSpace(line[i]))
 					++i;
 				if(i < line.size())
 				{
@@ -251,7 +440,7 @@ void Data::Load(const string &path)
 					// That will keep lines in separate files from being
 					// interpreted as part of the same data block.
 					lines.emplace_back();
-					Load(directory + line.substr(i));
+					Load(directory + string(line.substr(i)));
 					lines.emplace_back();
 					directories.emplace_back(lines.size(), directory);
 				}
@@ -259,8 +448,7 @@ void Data::Load(const string &path)
 			}
 		}
 		// Append this line to the list.
-		lines.emplace_back();
-		lines.back().swap(line);
+		lines.push_back(line);
 	}
 }
 
@@ -277,6 +465,7 @@ bool Data::Tokenize()
 	++lineIndex;
 	
 	tokens.clear();
+	keyword = OTHER;
 	if(it == end)
 		return false;
 	
@@ -284,7 +473,7 @@ bool Data::Tokenize()
 	bool was = true;
 	for(size_t i = 0; i < it->size(); ++i)
 	{
-		bool is = isspace((*it)[i]);
+		bool is = IsSpace((*it)[i]);
 		if(is != was)
 			tokens.push_back(i);
 		was = is;
@@ -293,5 +482,10 @@ bool Data::Tokenize()
 	if(tokens.size() % 2)
 		tokens.push_back(it->size());
 	
+	// Look up the tag, so that it only has to be compared to the keywords once.
+	string_view tag = TagView();
+	const string_view *found = lower_bound(std::begin(NAMES), std::end(NAMES), tag);
+	keyword = (found != std::end(NAMES) && *found == tag) ? static_cast<Keyword>(found - NAMES + 1) : OTHER;
+	
 	return true;
 }
@@ -7,8 +7,10 @@ Copyright 2020 Michael Zahniser
 
 #include "Point.h"
 
+#include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -20,14 +22,31 @@ using namespace std;
 // are broken up into "tokens" by whitespace. Some lines may be stand-alone
 // commands, and others may be "blocks" of data terminated by an empty line.
 // Comments (lines beginning with #) and file inclusion (include <path>) are
-// supported.
+// supported. Files are mapped into memory rather than copied, and each line is
+// a view into that memory, so loading does not allocate anything per line.
 class Data {
+public:
+	// The tags that the game's loaders look for. Each line's tag is looked up
+	// once, when it is tokenized, so that loaders can switch on it instead of
+	// comparing strings. Any other tag is OTHER. These must stay in
+	// alphabetical order.
+	enum Keyword {OTHER, ACTIVE, ADD, ANIMATION, ASK, AVATAR, BACKGROUND, BASELINE,
+		BOLD, BOUNDS, CACHE, COLOR, COMPOSITOR, DIALOG, ELSE, ENTER, EXIT, FACE,
+		FAMILY, FPS, FULLSCREEN, GAME, GOTO, ICON, IF, INDEX, INIT, INTERACTION,
+		ITALIC, LAYER, MASK, MENU, NORMAL, OFFSET, OPTION, POSITION, REMOVE, ROOM,
+		SAY, SCENE, SET, SHEET, SIZE, SPEED, SPRITE, STATS, STYLE, VISIBLE, WINDOW,
+		KEYWORDS};
+		
+		
 public:
 	// Don't allow copying a Data object, but do allow moving.
 	Data();
 	Data(const Data &) = delete;
 	Data(Data &&) = default;
 	Data(const string &path);
+	// Make a Data object from the given lines. It keeps its own copy of them,
+	// so they do not need to outlive it, and its views stay valid even if the
+	// original list is changed.
 	Data(const vector<string> &lines);
 	
 	Data &operator=(const Data &) = delete;
@@ -51,17 +70,24 @@ public:
 	size_t Size() const;
 	
 	// Get the entire line as one string, including leading and trailing space.
-	const string &Line() const;
+	string_view Line() const;
 	// Get the "tag," i.e. the first word of the line.
 	string Tag() const;
 	// Get the "value," i.e. all the text after the first word. For some data
 	// types this will be a single field, and for others it may contain multiple
 	// fields separated by whitespace. Trailing spaces are trimmed out.
 	string Value(size_t index = 1) const;
+	// Get the tag or value the same way, but without copying it. The view is
+	// valid for as long as this Data object is.
+	string_view TagView() const;
+	string_view ValueView(size_t index = 1) const;
+	// Get the tag as a keyword, or OTHER if it is not one of them.
+	Keyword Key() const;
 	// Get the current line's indent, in characters. All characters count the
 	// same, so a tab is the same as a single space, not multiple spaces.
 	int Indent() const;
-	// Get the given whitespace-separated argument.
+	// Get the given whitespace-separated argument. If the line does not have
+	// that many arguments, it is empty.
 	class Arg;
 	Arg operator[](size_t index) const;
 	
@@ -71,7 +97,7 @@ public:
 	// variety of ways.
 	class Arg {
 	public:
-		Arg(const string &line, size_t start, size_t end);
+		Arg(string_view line, size_t start, size_t end);
 		
 		// Allow an argument to be typecast to any of the following types.
 		operator string() const;
@@ -84,12 +110,17 @@ public:
 		bool IsInt() const;
 		
 	private:
-		const string &line;
+		const string_view line;
 		const size_t start;
 		const size_t end;
 	};
 	
 	
+private:
+	// The contents of a file, mapped into memory if possible.
+	class File;
+	
+	
 private:
 	// Load lines from the given file, appending to the existing lines rather
 	// than replacing them. This allows recursive "include" commands.
@@ -99,10 +130,15 @@ private:
 	
 	
 private:
-	vector<string> lines;
-	vector<string>::const_iterator it;
-	vector<string>::const_iterator end;
+	vector<shared_ptr<const File>> files;
+	// The lines this was made from, if it was not loaded from a file. They are
+	// shared, not copied, when this object is moved, so they never move.
+	shared_ptr<const vector<string>> copy;
+	vector<string_view> lines;
+	vector<string_view>::const_iterator it;
+	vector<string_view>::const_iterator end;
 	vector<size_t> tokens;
+	Keyword keyword = OTHER;
 	
 	size_t lineIndex = 0;
 	string directory;
@@ -5,8 +5,11 @@ Copyright 2020 Michael Zahniser
 #include "Dialog.h"
 
 #include "Color.h"
+#include "Compositor.h"
 #include "Sprite.h"
+#include "Stats.h"
 #include "Text.h"
+#include "Trace.h"
 #include "Variables.h"
 #include "World.h"
 
@@ -47,9 +50,9 @@ namespace {
 	// Draw a rectangle with a frame around it.
 	void FrameRect(SDL_Surface *surface, Rect rect, const Color &color)
 	{
-		SDL_FillRect(surface, &rect, LINE_COLOR(surface));
+		Compositor::Fill(surface, &rect, LINE_COLOR(surface));
 		rect.Grow(-1);
-		SDL_FillRect(surface, &rect, color(surface));
+		Compositor::Fill(surface, &rect, color(surface));
 	}
 }
 
@@ -61,17 +64,17 @@ void Dialog::Load(Data &data)
 	Node &node = nodes[data.Value()];
 	while(data.Next() && data.Size())
 	{
-		if(data.Tag() == "ask")
+		if(data.Key() == Data::ASK)
 			node.ask = data.Value();
 		else
-			node.push_back(data.Line());
+			node.emplace_back(data.Line());
 	}
 }
 
 
 
 Dialog::Dialog(World &world)
-	: world(world)
+	: world(world), layout(WRAP_WIDTH)
 {
 }
 
@@ -135,8 +138,9 @@ bool Dialog::IsOpen() const
 // highlight it.
 void Dialog::Draw(SDL_Surface *screen, Point hover) const
 {
-	Text wrap(WRAP_WIDTH);
-	wrap.Wrap(text);
+	STATS_TIMER(DIALOG);
+	
+	Layout();
 
 	// The dialog box is laid out as follows:
 	// First, the scene (if any), centered horizontally and occupying the whole
@@ -144,7 +148,7 @@ void Dialog::Draw(SDL_Surface *screen, Point hover) const
 	// Then, the icon and the text side by side, with BOX_PAD between them. If
 	// there is extra width (because of a wide scene) they are centered.
 	// TODO: Is there any way to simplify this math?
-	Point dialogSize(wrap.Width(), wrap.Height());
+	Point dialogSize(layout.Width(), layout.Height());
 	if(icon)
 	{
 		const Sprite &sprite = Sprite::Get(icon);
@@ -161,6 +165,7 @@ void Dialog::Draw(SDL_Surface *screen, Point hover) const
 	Point corner((screen->w - dialogSize.X()) / 2, DIALOG_Y);
 	Rect rect(corner - BOX_PAD, corner + dialogSize + BOX_PAD);
 	FrameRect(screen, rect, DIALOG_COLOR);
+	textRect = rect;
 	
 	// Draw the scene, icon, and text.
 	if(scene)
@@ -174,7 +179,7 @@ void Dialog::Draw(SDL_Surface *screen, Point hover) const
 		corner.Y() += height;
 		dialogSize.Y() -= height;
 	}
-	int width = wrap.Width();
+	int width = layout.Width();
 	if(icon)
 	{
 		const Sprite &sprite = Sprite::Get(icon);
@@ -183,30 +188,36 @@ void Dialog::Draw(SDL_Surface *screen, Point hover) const
 		sprite.Draw(screen, corner - sprite.Bounds().TopLeft() + Point(hPad, 0));
 	}
 	// Given the width of this entire lower section, calculate the text offset.
-	corner.X() += (dialogSize.X() + width) / 2 - wrap.Width();
-	wrap.Draw(screen, corner + TEXT_OFFSET);
+	corner.X() += (dialogSize.X() + width) / 2 - layout.Width();
+	layout.Draw(screen, corner + TEXT_OFFSET);
 	// Options should only be as wide as the text.
-	dialogSize.X() = wrap.Width();
+	dialogSize.X() = layout.Width();
 	
 	// Show the options, or else a prompt to continue.
-	static const vector<string> PROMPT = {"(Click anywhere to continue.)"};
-	string number = "0: ";
 	optionRects.clear();
-	for(const string &option : optionText.empty() ? PROMPT : optionText)
+	for(const Text &option : optionLayouts)
 	{
 		corner.Y() += dialogSize.Y() + OPTION_PAD;
-		++number[0];
-		wrap.Wrap(number + option);
-		dialogSize.Y() = wrap.Height();
+		dialogSize.Y() = option.Height();
 		rect = Rect(corner - BOX_PAD, corner + dialogSize + BOX_PAD);
 		FrameRect(screen, rect, rect.Contains(hover) ? HOVER_COLOR : OPTION_COLOR);
-		wrap.Draw(screen, corner + TEXT_OFFSET);
+		option.Draw(screen, corner + TEXT_OFFSET);
 		optionRects.push_back(rect);
 	}
 }
 
 
 
+// Add to the given list the screen rectangles the dialog covered when it
+// was last drawn.
+void Dialog::Damage(vector<Rect> &rects) const
+{
+	rects.push_back(textRect);
+	rects.insert(rects.end(), optionRects.begin(), optionRects.end());
+}
+
+
+
 // Handle an event, and return true if the screen needs to be redrawn.
 bool Dialog::Handle(const SDL_Event &event)
 {
@@ -285,93 +296,103 @@ void Dialog::Acknowledge()
 
 void Dialog::Step()
 {
+	Trace::Span span("Dialog::Step");
+	
+	isLaidOut = false;
 	// The scene resets every page. The icon persists.
 	scene = 0;
 	bool spoke = false;
 	while(data)
 	{
-		// Special case: a "goto" node moves us to new data immediately.
-		if(data.Tag() == "goto")
+		switch(data.Key())
 		{
-			data = Data(nodes[data.Value()]);
-			// Process this line instead of advancing to the next one.
-			continue;
-		}
-		else if(data.Tag() == "if")
-		{
-			if(!Variables::Eval(data.Value()))
-			{
+			// Special case: a "goto" node moves us to new data immediately.
+			case Data::GOTO:
+				data = Data(nodes[data.Value()]);
+				// Process this line instead of advancing to the next one.
+				continue;
+			case Data::IF:
+				if(!Variables::Eval(data.Value()))
+				{
+					SkipBlock(data);
+					// We are now at the first line after the end of the "if"
+					// block that we skipped. If that line is an "else" we can
+					// skip that line and move on into the contents of the else.
+					// Otherwise, we need to "continue" to avoid advancing past
+					// this line.
+					if(data.Key() != Data::ELSE)
+						continue;
+				}
+				break;
+			case Data::ELSE:
+				// If we got to this line, it means we didn't skip the previous
+				// "if" clause, so we need to skip this one.
 				SkipBlock(data);
-				// We are now at the first line after the end of the "if" block
-				// that we skipped. If that line is an "else" we can skip that
-				// line and move on into the contents of the else. Otherwise, we
-				// need to "continue" to avoid advancing past this line.
-				if(data.Tag() != "else")
-					continue;
-			}
-		}
-		else if(data.Tag() == "else")
-		{
-			// If we got to this line, it means we didn't skip the previous "if"
-			// clause, so we need to skip this one.
-			SkipBlock(data);
-			// We don't need to call data.Next() because it is already at the
-			// first line after the block.
-			continue;
-		}
-		else if(data.Tag() == "option")
-		{
-			if(!visited.count(data.Value()))
-				options.push_back(data.Value());
-		}
-		else if(data.Tag() == "exit")
-			exitText = data.Size() > 1 ? data.Value() : "(End conversation.)";
-		else if(data.Tag() == "icon")
-			icon = data[1];
-		else if(data.Tag() == "scene")
-			scene = data[1];
-		else if(data.Tag() == "add")
-		{
-			string room = data.Value();
-			int indent = data.Indent();
-			data.Next();
-			while(data.Indent() > indent)
+				// We don't need to call data.Next() because it is already at
+				// the first line after the block.
+				continue;
+			case Data::OPTION:
+				if(!visited.count(data.Value()))
+					options.push_back(data.Value());
+				break;
+			case Data::EXIT:
+				exitText = data.Size() > 1 ? data.Value() : "(End conversation.)";
+				break;
+			case Data::ICON:
+				icon = data[1];
+				break;
+			case Data::SCENE:
+				scene = data[1];
+				break;
+			case Data::ADD:
 			{
-				if(data.Tag() == "interaction")
-					world.Add(Interaction(data), room);
-				else
+				string room = data.Value();
+				int indent = data.Indent();
+				data.Next();
+				while(data.Indent() > indent)
 				{
-					world.Add(data[0], data[1], data.Value(2), room);
-					data.Next();
+					if(data.Key() == Data::INTERACTION)
+						world.Add(Interaction(data), room);
+					else
+					{
+						world.Add(data[0], data[1], data.Value(2), room);
+						data.Next();
+					}
 				}
+				// Return to the top of the loop without calling data.Next()
+				// again.
+				continue;
 			}
-			// Return to the top of the loop without calling data.Next() again.
-			continue;
-		}
-		else if(data.Tag() == "remove")
-		{
-			string room = data.Value();
-			int indent = data.Indent();
-			while(data.Next() && data.Indent() > indent)
-				world.Remove(data.Value(0), room);
-			// Return to the top of the loop without calling data.Next() again.
-			continue;
-		}
-		else if(data.Tag() == "enter")
-			world.Enter(data[1], data[2]);
-		else if(data.Tag() == "face")
-			world.Face(data[1]);
-		else if(data.Tag() == "set")
-			Variables::Set(data.Value());
-		else if(data.Tag() == "say")
-		{
-			// If we've reached another "say" line, that means the current
-			// "paragraph" should be shown immediately, and we don't need to
-			// show options because we're not yet at the end of the stream.
-			if(spoke)
-				return;
-			spoke = true;
-			text = data.Value();
+			case Data::REMOVE:
+			{
+				string room = data.Value();
+				int indent = data.Indent();
+				while(data.Next() && data.Indent() > indent)
+					world.Remove(data.Value(0), room);
+				// Return to the top of the loop without calling data.Next()
+				// again.
+				continue;
+			}
+			case Data::ENTER:
+				world.Enter(data[1], data[2]);
+				break;
+			case Data::FACE:
+				world.Face(data[1]);
+				break;
+			case Data::SET:
+				Variables::Set(data.Value());
+				break;
+			case Data::SAY:
+				// If we've reached another "say" line, that means the current
+				// "paragraph" should be shown immediately, and we don't need to
+				// show options because we're not yet at the end of the stream.
+				if(spoke)
+					return;
+				spoke = true;
+				text = data.Value();
+				break;
+			default:
+				break;
 		}
 		// If we didn't "continue" up above, advance to the next line.
 		data.Next();
@@ -388,6 +409,7 @@ void Dialog::Step()
 
 void Dialog::ClearOptions()
 {
+	isLaidOut = false;
 	// Begin accumulating options from scratch.
 	optionText.clear();
 	options.clear();
@@ -399,6 +421,28 @@ void Dialog::ClearOptions()
 
 
 
+// Wrap the text and the options, if they have changed.
+void Dialog::Layout() const
+{
+	if(isLaidOut)
+		return;
+	
+	layout.Wrap(text);
+	// Show the options, or else a prompt to continue.
+	static const vector<string> PROMPT = {"(Click anywhere to continue.)"};
+	string number = "0: ";
+	optionLayouts.clear();
+	for(const string &option : optionText.empty() ? PROMPT : optionText)
+	{
+		++number[0];
+		optionLayouts.emplace_back(WRAP_WIDTH);
+		optionLayouts.back().Wrap(number + option);
+	}
+	isLaidOut = true;
+}
+
+
+
 // Check if the given point is inside one of the options. If not, this
 // returns the size of the options vector.
 size_t Dialog::Button(Point p)
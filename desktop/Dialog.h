@@ -8,6 +8,7 @@ Copyright 2020 Michael Zahniser
 #include "Data.h"
 #include "Point.h"
 #include "Rect.h"
+#include "Text.h"
 
 #include <SDL2/SDL.h>
 
@@ -45,6 +46,9 @@ public:
 	// Draw the dialog. If the given mouse position is on one of the options,
 	// highlight it.
 	void Draw(SDL_Surface *screen, Point hover) const;
+	// Add to the given list the screen rectangles the dialog covered when it
+	// was last drawn.
+	void Damage(vector<Rect> &rects) const;
 	// Handle an event, and return true if the screen needs to be redrawn.
 	bool Handle(const SDL_Event &event);
 	
@@ -59,6 +63,8 @@ private:
 	// Step forward to the next "say" block.
 	void Step();
 	void ClearOptions();
+	// Wrap the text and the options, if they have changed.
+	void Layout() const;
 	// Check if the given point is inside one of the options. If not, this
 	// returns the size of the options vector.
 	size_t Button(Point p);
@@ -79,7 +85,13 @@ private:
 	
 	// Information stored behind the scenes.
 	vector<string> options;
+	mutable Rect textRect;
 	mutable vector<Rect> optionRects;
+	// The wrapped text and options. Wrapping is slow, so it is only redone
+	// when the dialog moves on to a new page.
+	mutable bool isLaidOut = false;
+	mutable Text layout;
+	mutable vector<Text> optionLayouts;
 	string exitText;
 	set<string> visited;
 };
@@ -12,7 +12,8 @@ using namespace std;
 
 
 
-// This class represents an iterator over the edges of a part of a polygon.
+// This class represents an iterator over the edges of a part of a polygon. It
+// is defined entirely in this header so the polygon loops can inline it.
 class Edge {
 public:
 	Edge() = default;
@@ -33,7 +34,7 @@ public:
 	Point Vector() const;
 	// Get the current "order" value, i.e. the sum of squared edge lengths
 	// of all edges prior to this one.
-	int Order() const;
+	Point::Product Order() const;
 	
 	
 private:
@@ -41,9 +42,82 @@ private:
 	Point v;
 	const Point *it = nullptr;
 	const Point *end = nullptr;
-	int order = 0.f;
+	Point::Product order = 0;
 };
 
 
 
+inline Edge::Edge(const Ring &ring)
+	: start(ring.back()), v(ring.front() - start), it(&ring.front()), end(it + ring.size())
+{
+}
+
+
+
+// Increment the iterators.
+inline void Edge::operator++()
+{
+	order += v.Dot(v);
+	start = *it;
+	++it;
+	if(it != end)
+		v = *it - start;
+}
+
+
+
+inline void Edge::operator++(int)
+{
+	++*this;
+}
+
+
+
+// Check if we've reached the end of this ring.
+inline Edge::operator bool() const
+{
+	return (it != end);
+}
+
+
+
+inline bool Edge::operator!() const
+{
+	return (it == end);
+}
+
+
+
+// Get the current start and end points.
+inline Point Edge::Start() const
+{
+	return start;
+}
+
+
+
+inline Point Edge::End() const
+{
+	return *it;
+}
+
+
+
+// Get the edge vector, i.e. End() - Start().
+inline Point Edge::Vector() const
+{
+	return v;
+}
+
+
+
+// Get the current "order" value, i.e. the sum of squared edge lengths
+// of all edges prior to this one.
+inline Point::Product Edge::Order() const
+{
+	return order;
+}
+
+
+
 #endif
@@ -4,11 +4,23 @@ Copyright 2020 Michael Zahniser
 
 #include "Font.h"
 
-#include <SDL2/SDL_image.h>
+#include "Bundle.h"
+#include "Compositor.h"
+#include "Stats.h"
+#include "Trace.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
 #include <map>
+#include <thread>
+#include <unordered_map>
+
+#include <dirent.h>
 
 using namespace std;
 
@@ -32,10 +44,69 @@ namespace {
 	map<string, Font::Metrics> baseMetrics;
 	map<string, Font> fonts;
 	
+	// The format that Font::Prepare() converts the glyph sheets to, and whether
+	// they can use span masks in that format. Pages that are loaded after that
+	// are converted the same way.
+	uint32_t sheetFormat = SDL_PIXELFORMAT_UNKNOWN;
+	bool hasMasks = false;
+	
 	// Minimum spacing to add between glyphs in addition to the advance.
 	const int KERN = 2;
-	// Map a character to a glyph index.
-	int Glyph(char c, bool isAfterSpace);
+	// The glyph on the main sheet that is drawn for characters no sheet has.
+	const int MISSING = Font::Metrics::GLYPHS - 3;
+	// Map an ASCII character to a glyph index.
+	int GlyphIndex(char c, bool isAfterSpace);
+	// Decode the UTF-8 character that starts at the given position.
+	uint32_t Decode(const char *it, const char *end);
+	// Load a glyph sheet, in a 32-bit format.
+	SDL_Surface *LoadSheet(const string &path);
+	// Get the path of the given page of glyphs for the font with the given
+	// main sheet, or of the cached kerning for that sheet.
+	string PagePath(const string &path, uint32_t number);
+	string KerningPath(const string &path);
+	// Get the names of all the files in the given directory, in sorted order.
+	vector<string> ListDirectory(const string &path);
+	// Get the advance for the given two glyphs, from their edges.
+	int FindAdvance(const int *right, const int *left, int height);
+	
+	// Fill in the advance table for the given glyph sheet.
+	void FindKerning(const Font::Metrics::Page &page, int height, int *advance);
+	// Get a hash of the given glyph sheet's size and pixels.
+	uint64_t Hash(const SDL_Surface *glyphs);
+	// Read or write a cached advance table.
+	bool LoadKerning(const string &path, uint64_t hash, int *advance);
+	void SaveKerning(const string &path, uint64_t hash, const int *advance);
+	
+	// A string of glyphs that has been drawn onto a surface of its own. If
+	// that was not possible, the surface is null.
+	class Rendered {
+	public:
+		explicit Rendered(const string &key);
+		Rendered(const Rendered &) = delete;
+		~Rendered();
+		
+		string key;
+		SDL_Surface *surface = nullptr;
+		Blitter mask;
+		// Offset from the corner of the text to the corner of the surface.
+		Point offset;
+		// Memory used by this entry.
+		size_t bytes = 0;
+		// The compositor frame in which this was last drawn.
+		uint64_t frame = 0;
+	};
+	// The cached text, with the most recently drawn first.
+	list<Rendered> cache;
+	unordered_map<string, list<Rendered>::iterator> cacheIndex;
+	size_t cacheSize = 4 << 20;
+	size_t cacheMemory = 0;
+	
+	// Get the key for caching the given glyphs.
+	string CacheKey(const vector<Font::Glyph> &text);
+	// Check if the given cache entry can be freed now.
+	bool IsUnused(const Rendered &entry);
+	// Free the least recently used cache entry.
+	void Evict();
 }
 
 
@@ -53,25 +124,35 @@ void Font::SetDirectory(const string &path)
 void Font::Add(Data &data)
 {
 	string name = data.Value();
+	Trace::Span span("Font::Add", name);
 	Style style = defaultStyle;
 	// Then, read any overrides for those defaults.
 	while(data.Next() && data.Size())
 	{
-		if(data.Tag() == "family")
-			style.family = data.Value();
-		if(data.Tag() == "size")
-			style.size = data[1];
-		else if(data.Tag() == "bold")
-			style.weight = "bold";
-		else if(data.Tag() == "italic")
-			style.style = "italic";
-		else if(data.Tag() == "normal")
+		switch(data.Key())
 		{
-			style.weight.clear();
-			style.style.clear();
+			case Data::FAMILY:
+				style.family = data.Value();
+				break;
+			case Data::SIZE:
+				style.size = data[1];
+				break;
+			case Data::BOLD:
+				style.weight = "bold";
+				break;
+			case Data::ITALIC:
+				style.style = "italic";
+				break;
+			case Data::NORMAL:
+				style.weight.clear();
+				style.style.clear();
+				break;
+			case Data::COLOR:
+				style.color = Color(data[1], data[2], data[3]);
+				break;
+			default:
+				break;
 		}
-		else if(data.Tag() == "color")
-			style.color = Color(data[1], data[2], data[3]);
 	}
 	// If this style is unnamed, it is the default style.
 	if(name.empty())
@@ -105,76 +186,262 @@ const Font &Font::Get(const string &name)
 
 
 
+// Convert the glyph sheets to an alpha format matching the given pixel
+// format (normally that of the window surface), and build a span mask for
+// each glyph.
+void Font::Prepare(const SDL_PixelFormat *format)
+{
+	// Keep the same channel order as the display, but with an alpha channel.
+	uint32_t rgb = format->Rmask | format->Gmask | format->Bmask;
+	uint32_t alphaFormat = SDL_PIXELFORMAT_UNKNOWN;
+	if(format->BytesPerPixel == 4)
+		alphaFormat = SDL_MasksToPixelFormatEnum(32, format->Rmask, format->Gmask, format->Bmask, ~rgb);
+	if(alphaFormat == SDL_PIXELFORMAT_UNKNOWN)
+		alphaFormat = SDL_PIXELFORMAT_ARGB8888;
+	
+	SDL_PixelFormat *sheet = SDL_AllocFormat(alphaFormat);
+	if(!sheet)
+		return;
+	sheetFormat = alphaFormat;
+	hasMasks = Blitter::IsSupported(sheet, format);
+	SDL_FreeFormat(sheet);
+	
+	// Any cached text was drawn from the old sheets.
+	while(!cache.empty())
+		Evict();
+	
+	// Every color of a font is drawn from the same sheets.
+	for(auto &it : baseMetrics)
+	{
+		it.second.base.Prepare();
+		for(auto &page : it.second.pages)
+			page.second.Prepare();
+	}
+}
+
+
+
 // Free all the glyph sheets.
 void Font::FreeAll()
 {
+	while(!cache.empty())
+		Evict();
 	fonts.clear();
+	for(auto &it : baseMetrics)
+	{
+		if(it.second.base.glyphs)
+			SDL_FreeSurface(it.second.base.glyphs);
+		for(auto &page : it.second.pages)
+			if(page.second.glyphs)
+				SDL_FreeSurface(page.second.glyphs);
+	}
 	baseMetrics.clear();
+	sheetFormat = SDL_PIXELFORMAT_UNKNOWN;
 }
 
 
 
-// Destructor.
-Font::~Font()
+// Get the memory used by all the glyph sheets.
+size_t Font::Memory()
 {
-	if(glyphs)
-		SDL_FreeSurface(glyphs);
+	size_t bytes = 0;
+	for(const auto &it : baseMetrics)
+	{
+		if(it.second.base.glyphs)
+			bytes += it.second.base.glyphs->pitch * it.second.base.glyphs->h;
+		for(const auto &page : it.second.pages)
+			if(page.second.glyphs)
+				bytes += page.second.glyphs->pitch * page.second.glyphs->h;
+	}
+	return bytes;
 }
 
 
 
-// Draw the given string, with its top left corner at the given (x, y).
-void Font::Draw(const string &text, Point point, SDL_Surface *surface) const
+// Get the paths of all the files that the loaded fonts are drawn from: each
+// main glyph sheet and its cached kerning, and any other pages of glyphs that
+// exist for it, even if they have not been loaded yet.
+vector<string> Font::Files()
 {
-	bool isAfterSpace = true;
-	
-	// The bounding box of the output glyph:
-	Rect rect(point);
-	// Keep track of the previous non-space character, for kerning:
-	int prev = 0;
-	for(const char *it = text.data(); *it; ++it)
+	// Most pages do not exist, so instead of checking for each one, list each
+	// font directory once and pick out the pages from that.
+	map<string, vector<string>> listings;
+	vector<string> files;
+	for(const auto &it : baseMetrics)
 	{
-		// Select curly quotes based on whether the most recent non-quote
-		// character was a space.
-		int next = Glyph(*it, isAfterSpace);
-		if(*it != '"' && *it != '\'')
-			isAfterSpace = !next;
+		files.push_back(it.first);
+		files.push_back(KerningPath(it.first));
 		
-		if(!next)
-			rect.x += metrics.space;
-		else
+		size_t slash = it.first.rfind('/') + 1;
+		string directory = it.first.substr(0, slash);
+		auto listing = listings.find(directory);
+		if(listing == listings.end())
+			listing = listings.emplace(directory, ListDirectory(directory)).first;
+		
+		// A page's name is the sheet's name, without the extension, followed
+		// by "-u" and its number in hexadecimal.
+		string prefix = it.first.substr(slash, it.first.rfind('.') - slash) + "-u";
+		for(const string &name : listing->second)
 		{
-			rect.x += metrics.Advance(prev, next);
-			SDL_BlitSurface(glyphs, &metrics.box[next], surface, &rect);
-			prev = next;
+			if(name.compare(0, prefix.size(), prefix))
+				continue;
+			
+			unsigned long number = strtoul(name.c_str() + prefix.size(), nullptr, 16);
+			if(number <= 0x10FFFF / Metrics::PAGE_SIZE && PagePath(it.first, number) == directory + name)
+				files.push_back(directory + name);
 		}
 	}
+	return files;
 }
 
 
 
-// Get the width of the given string.
-int Font::Width(const string &text) const
+// Draw the given UTF-8 string, with its top left corner at the given (x, y).
+void Font::Draw(const string &text, Point point, SDL_Surface *surface) const
 {
-	bool isAfterSpace = true;
-	int width = 0;
-	int prev = 0;
+	Measure measure(*this);
 	for(const char *it = text.data(); *it; ++it)
 	{
-		int next = Glyph(*it, isAfterSpace);
-		if(*it != '"' && *it != '\'')
-			isAfterSpace = !next;
-		
-		if(!next)
-			width += metrics.space;
-		else
+		int index = measure.Add(*it);
+		if(index)
 		{
-			width += metrics.Advance(prev, next);
-			prev = next;
+			Rect rect(point + Point(measure.Offset(), 0));
+			Compositor::Blit(metrics.Mask(index), metrics.Sheet(index), &metrics.Box(index), surface, &rect, color);
 		}
 	}
-	// Include the advance to get to the end of the last character.
-	return width + metrics.Advance(prev);
+}
+
+
+
+// Draw the given glyphs, offset by the given amount.
+void Font::Draw(const vector<Glyph> &text, Point corner, SDL_Surface *surface)
+{
+	for(const Glyph &glyph : text)
+	{
+		const Metrics &metrics = glyph.font->metrics;
+		Rect rect(corner + glyph.point);
+		Compositor::Blit(metrics.Mask(glyph.index), metrics.Sheet(glyph.index), &metrics.Box(glyph.index), surface, &rect, glyph.font->color);
+	}
+}
+
+
+
+// Draw the given glyphs the same way, but with a single blit of a surface
+// that they have already been drawn onto.
+void Font::DrawCached(const vector<Glyph> &text, Point corner, SDL_Surface *surface)
+{
+	if(text.empty() || !cacheSize)
+	{
+		Draw(text, corner, surface);
+		return;
+	}
+	
+	string key = CacheKey(text);
+	auto it = cacheIndex.find(key);
+	if(it != cacheIndex.end())
+	{
+		STATS_COUNT(TEXT_HITS, 1);
+		cache.splice(cache.begin(), cache, it->second);
+	}
+	else
+	{
+		STATS_COUNT(TEXT_MISSES, 1);
+		// Text that could never fit in the cache is not rendered at all. Like
+		// text whose glyphs overlap, it is cached without a surface, so it is
+		// drawn glyph by glyph without being tried again.
+		Rect bounds = Bounds(text);
+		bool fits = (key.size() + static_cast<size_t>(bounds.w) * bounds.h * 4 <= cacheSize);
+		Point offset;
+		SDL_Surface *rendered = (fits ? Render(text, offset) : nullptr);
+		size_t bytes = key.size() + (rendered ? rendered->pitch * rendered->h : 0);
+		// Make room for the new entry, but don't free anything that the
+		// compositor may still need to draw this frame.
+		while(cacheMemory + bytes > cacheSize && !cache.empty() && IsUnused(cache.back()))
+			Evict();
+		if(cacheMemory + bytes > cacheSize)
+		{
+			if(rendered)
+				SDL_FreeSurface(rendered);
+			Draw(text, corner, surface);
+			return;
+		}
+		
+		cache.emplace_front(key);
+		Rendered &entry = cache.front();
+		entry.surface = rendered;
+		if(rendered)
+			entry.mask = Blitter(rendered, Rect(0, 0, rendered->w, rendered->h));
+		entry.offset = offset;
+		entry.bytes = bytes;
+		cacheIndex[key] = cache.begin();
+		cacheMemory += bytes;
+	}
+	
+	Rendered &entry = cache.front();
+	entry.frame = Compositor::Frames();
+	// The cached surface is only identical to drawing the glyphs one by one
+	// if it is drawn with its span mask.
+	if(!entry.surface || !entry.mask.IsValid() || !Blitter::IsSupported(entry.surface->format, surface->format))
+	{
+		Draw(text, corner, surface);
+		return;
+	}
+	Rect from(0, 0, entry.surface->w, entry.surface->h);
+	Rect to = from + (corner + entry.offset);
+	Compositor::Blit(entry.mask, entry.surface, &from, surface, &to);
+}
+
+
+
+// Set the most memory, in bytes, that the cached text may use. If this is
+// 0, nothing is cached.
+void Font::SetCacheSize(size_t bytes)
+{
+	cacheSize = bytes;
+	while(cacheMemory > cacheSize && !cache.empty() && IsUnused(cache.back()))
+		Evict();
+}
+
+
+
+// Get the memory, in bytes, that the cached text is using now.
+size_t Font::CacheMemory()
+{
+	return cacheMemory;
+}
+
+
+
+// Lay out the given string with its top left corner at the given point, and
+// add its glyphs to the given list.
+void Font::Layout(const string &text, Point point, vector<Glyph> &glyphs) const
+{
+	Measure measure(*this);
+	for(const char *it = text.data(); *it; ++it)
+	{
+		int index = measure.Add(*it);
+		if(index)
+			glyphs.push_back(Glyph{this, index, point + Point(measure.Offset(), 0)});
+	}
+}
+
+
+
+// Get the width of the given string.
+int Font::Width(const string &text) const
+{
+	Measure measure(*this);
+	for(const char *it = text.data(); *it; ++it)
+		measure.Add(*it);
+	return measure.Width();
+}
+
+
+
+// Get the height of the glyphs.
+int Font::Height() const
+{
+	return metrics.Box(0).h;
 }
 
 
@@ -182,23 +449,33 @@ int Font::Width(const string &text) const
 // Get the kerning adjustment for when the given first string is followed by
 // the given second string.
 int Font::Kern(const string &first, const string &second) const
+{
+	return Kern(first, second.data(), second.data() + second.size());
+}
+
+
+
+int Font::Kern(const string &first, const char *begin, const char *end) const
 {
 	// Find the last non-space character of the first string and the first non-
-	// space character of the second.
+	// space character of the second. If the last one is more than one byte
+	// long, back up to its first byte.
 	size_t fit = first.size();
-	while(fit && isspace(first[--fit]))
+	while(fit && isspace(static_cast<unsigned char>(first[--fit])))
 		continue;
-	size_t sit = 0;
-	while(sit < second.size() && isspace(second[sit]))
+	while(fit && (first[fit] & 0xC0) == 0x80)
+		--fit;
+	const char *sit = begin;
+	while(sit != end && isspace(static_cast<unsigned char>(*sit)))
 		++sit;
 	
 	// Check whether we succeeded in finding non-space characters in each.
-	if(!fit || sit == second.size())
+	if(!fit || sit == end)
 		return 0;
 	// When selecting curly quotes, rather than figuring out for sure just
 	// assume that there's a space in between the strings.
-	int prev = Glyph(first[fit], false);
-	int next = Glyph(second[sit], true);
+	int prev = metrics.Index(Decode(first.data() + fit, first.data() + first.size()), false);
+	int next = metrics.Index(Decode(sit, end), true);
 	return metrics.Advance(prev, next) - metrics.Advance(prev);
 }
 
@@ -207,76 +484,67 @@ int Font::Kern(const string &first, const string &second) const
 // Initialize this Font by calculating the advances between glyphs.
 SDL_Surface *Font::Metrics::Init(const string &path)
 {
-	// Load the glyphs surface.
-	glyphs = IMG_Load(path.data());
+	// Load the main glyph sheet. The other pages are loaded when they are used.
+	this->path = path;
+	SDL_Surface *glyphs = LoadSheet(path);
 	if(!glyphs)
 		return nullptr;
 	
-	// Lock the surface for pixel access.
+	// The kerning table takes a while to calculate, so it is cached in a file
+	// beside the image, which is only used if the image has not changed.
 	SDL_LockSurface(glyphs);
-	
-	// Get the format and size of the surface.
-	int width = glyphs->w / GLYPHS;
-	int height = glyphs->h;
-	uint32_t mask = glyphs->format->Amask;
-	uint32_t half = 0x40404040 & mask;
-	int pitch = glyphs->pitch / glyphs->format->BytesPerPixel;
-	uint32_t *pixels = reinterpret_cast<uint32_t *>(glyphs->pixels);
-	
-	// advance[previous * GLYPHS + next] is the x advance for each glyph pair.
-	// There is no advance if the previous value is 0, i.e. we are at the very
-	// start of a string.
-	memset(advance, 0, GLYPHS * sizeof(advance[0]));
-	for(int prev = 1; prev < GLYPHS; ++prev)
-		for(int next = 0; next < GLYPHS; ++next)
-		{
-			int maxD = 0;
-			int glyphWidth = 0;
-			uint32_t *begin = pixels;
-			for(int y = 0; y < height; ++y)
-			{
-				// Find the last non-empty pixel in the previous glyph.
-				uint32_t *pend = begin + prev * width;
-				uint32_t *pit = pend + width;
-				while(pit != pend && (*--pit & mask) < half) {}
-				int distance = (pit - pend) + 1;
-				glyphWidth = max(distance, glyphWidth);
-				
-				// Special case: if "next" is zero (i.e. end of line of text),
-				// calculate the full width of this character. Otherwise:
-				if(next)
-				{
-					// Find the first non-empty pixel in this glyph.
-					uint32_t *nit = begin + next * width;
-					uint32_t *nend = nit + width;
-					while(nit != nend && (*nit++ & mask) < half) {}
-					
-					// How far apart do you want these glyphs drawn? If drawn at
-					// an advance of "width", there would be:
-					// pend + width - pit   <- pixels after the previous glyph.
-					// nit - (nend - width) <- pixels before the next glyph.
-					// So for zero kerning distance, you would want:
-					distance += 1 - (nit - (nend - width));
-				}
-				maxD = max(maxD, distance);
-				
-				// Update the pointer to point to the beginning of the next row.
-				begin += pitch;
-			}
-			// This is a fudge factor to avoid over-kerning, especially for the
-			// underscore and for glyph combinations like AV.
-			advance[prev * GLYPHS + next] = KERN + max(maxD, glyphWidth - 4);
-		}
+	uint64_t hash = Hash(glyphs);
 	SDL_UnlockSurface(glyphs);
+	base.Init(glyphs, GLYPHS);
+	string cachePath = KerningPath(path);
+	if(!LoadKerning(cachePath, hash, advance))
+	{
+		FindKerning(base, Box(0).h, advance);
+		SaveKerning(cachePath, hash, advance);
+	}
 	
 	// Set the space size based on the character width.
-	space = (width + 3) / 6 + 1;
+	space = (Box(0).w + 3) / 6 + 1;
 	
-	// Set the bounding box of each glyph.
-	for(int i = 0; i < GLYPHS; ++i)
-		box[i] = Rect(i * width, 0, width, height);
+	return base.glyphs;
+}
+
+
+
+// Get the glyph index for the given Unicode code point, loading the page that
+// it is on if this is the first time it has been used.
+int Font::Metrics::Index(uint32_t code, bool isAfterSpace)
+{
+	if(code < 0x80)
+		return GlyphIndex(code, isAfterSpace);
+	// The main sheet has the curly quotes, and a non-breaking space is blank.
+	if(code == 0x2018 || code == 0x201C)
+		return GlyphIndex(code == 0x2018 ? '\'' : '"', true);
+	if(code == 0x2019 || code == 0x201D)
+		return GlyphIndex(code == 0x2019 ? '\'' : '"', false);
+	if(code == 0xA0)
+		return 0;
 	
-	return glyphs;
+	uint32_t number = code / PAGE_SIZE;
+	auto it = pages.find(number);
+	if(it == pages.end())
+	{
+		// Remember the pages that do not exist, too, so that each file is only
+		// looked for once.
+		it = pages.emplace(number, Page()).first;
+		string pagePath = PagePath(path, number);
+		Trace::Span span("Font::LoadPage", pagePath);
+		SDL_Surface *glyphs = (base.glyphs ? LoadSheet(pagePath) : nullptr);
+		// Every page must have glyphs of the same size as the main sheet.
+		if(glyphs && (glyphs->w != PAGE_SIZE * Box(0).w || glyphs->h != Box(0).h))
+		{
+			SDL_FreeSurface(glyphs);
+			glyphs = nullptr;
+		}
+		if(glyphs)
+			it->second.Init(glyphs, PAGE_SIZE);
+	}
+	return (it->second.glyphs ? GLYPHS + code : MISSING);
 }
 
 
@@ -284,41 +552,295 @@ SDL_Surface *Font::Metrics::Init(const string &path)
 // Get the advance between the given two glyph indices.
 int Font::Metrics::Advance(int prev, int next) const
 {
-	return advance[prev * GLYPHS + next];
+	if(prev < GLYPHS && next < GLYPHS)
+		return advance[prev * GLYPHS + next];
+	// There is no advance at the very start of a string.
+	if(!prev)
+		return 0;
+	
+	int height = Box(0).h;
+	int slot = 0;
+	const Page &page = Find(prev, slot);
+	const int *right = &page.right[slot * height];
+	if(!next)
+		return FindAdvance(right, nullptr, height);
+	const Page &nextPage = Find(next, slot);
+	return FindAdvance(right, &nextPage.left[slot * height], height);
 }
 
 
 
-// Construct a font with the given metrics and color:
-Font::Font(const string &path, Metrics &metrics, const Color &color)
-	: metrics(metrics)
+// Get the sheet, bounding box, and span mask of the given glyph.
+SDL_Surface *Font::Metrics::Sheet(int index) const
 {
-	// The first font to use a given source image does not need to make a copy
-	// of the glyphs surface; it can just recolor it in place.
-	if(metrics.glyphs)
-		glyphs = SDL_ConvertSurface(metrics.glyphs, metrics.glyphs->format, 0);
-	else
-		glyphs = metrics.Init(path);
-	
-	// Color in the glyphs.
-	uint32_t mask = glyphs->format->Amask;
-	uint32_t rgb = color(glyphs) & ~mask;
+	int slot = 0;
+	return Find(index, slot).glyphs;
+}
+
+
+
+const Rect &Font::Metrics::Box(int index) const
+{
+	int slot = 0;
+	const Page &page = Find(index, slot);
+	return page.box[slot];
+}
+
+
+
+const Blitter &Font::Metrics::Mask(int index) const
+{
+	int slot = 0;
+	const Page &page = Find(index, slot);
+	return page.mask[slot];
+}
+
+
+
+// Get the page that the given glyph is on, and its position on it.
+const Font::Metrics::Page &Font::Metrics::Find(int index, int &slot) const
+{
+	if(index < GLYPHS)
+	{
+		slot = index;
+		return base;
+	}
+	// Glyphs are only given indices on other pages if those pages exist.
+	uint32_t code = index - GLYPHS;
+	slot = code % PAGE_SIZE;
+	return pages.find(code / PAGE_SIZE)->second;
+}
+
+
+
+// Take ownership of the given sheet, which is divided into the given number
+// of glyphs, and measure them.
+void Font::Metrics::Page::Init(SDL_Surface *sheet, int count)
+{
+	glyphs = sheet;
+	int width = glyphs->w / count;
+	int height = glyphs->h;
+	box.resize(count);
+	mask.resize(count);
+	for(int i = 0; i < count; ++i)
+		box[i] = Rect(i * width, 0, width, height);
 	
 	// Lock the surface for pixel access.
 	SDL_LockSurface(glyphs);
-	
+	uint32_t alpha = glyphs->format->Amask;
+	uint32_t half = 0x40404040 & alpha;
 	int pitch = glyphs->pitch / glyphs->format->BytesPerPixel;
 	uint32_t *pixels = reinterpret_cast<uint32_t *>(glyphs->pixels);
 	
-	for(int y = 0; y < glyphs->h; ++y)
+	// First, find the edges of each glyph in each row.
+	left.resize(count * height);
+	right.resize(count * height);
+	for(int g = 0; g < count; ++g)
+		for(int y = 0; y < height; ++y)
+		{
+			const uint32_t *begin = pixels + y * pitch + g * width;
+			int last = width - 1;
+			while(last > 0 && (begin[last] & alpha) < half)
+				--last;
+			right[g * height + y] = last + 1;
+			int first = 0;
+			while(first < width - 1 && (begin[first] & alpha) < half)
+				++first;
+			left[g * height + y] = first + 1;
+		}
+	
+	// Every font with these metrics is drawn from this sheet, in its own
+	// color, so make all the glyphs white.
+	uint32_t white = SDL_MapRGB(glyphs->format, 255, 255, 255) & ~alpha;
+	for(int y = 0; y < height; ++y)
 	{
 		uint32_t *it = pixels + y * pitch;
 		for(uint32_t *end = it + glyphs->w; it != end; ++it)
-			*it = (*it & mask) | rgb;
+			*it = (*it & alpha) | white;
 	}
-	
-	// Unlock the surface.
 	SDL_UnlockSurface(glyphs);
+	
+	// If this page is being loaded after Font::Prepare(), convert it now.
+	Prepare();
+}
+
+
+
+// Convert the sheet to the format that Font::Prepare() chose, if it has been
+// called, and build the span masks.
+void Font::Metrics::Page::Prepare()
+{
+	if(!glyphs || sheetFormat == SDL_PIXELFORMAT_UNKNOWN)
+		return;
+	
+	SDL_Surface *converted = SDL_ConvertSurfaceFormat(glyphs, sheetFormat, 0);
+	if(!converted)
+		return;
+	SDL_FreeSurface(glyphs);
+	glyphs = converted;
+	SDL_SetSurfaceBlendMode(glyphs, SDL_BLENDMODE_BLEND);
+	// The span masks need the original pixels, and the compositor can't use
+	// RLE at all.
+	SDL_SetSurfaceRLE(glyphs, !Compositor::IsEnabled() && !hasMasks);
+	for(size_t i = 0; i < box.size(); ++i)
+		mask[i] = (hasMasks ? Blitter(glyphs, box[i]) : Blitter());
+}
+
+
+
+Font::Measure::Measure(const Font &font)
+	: metrics(font.metrics)
+{
+}
+
+
+
+// Add the next byte of a UTF-8 string, and return the glyph index of the
+// character that it completes. Spaces and other blank characters have no
+// glyph, and neither do the leading bytes of a multi-byte character, so the
+// index is 0.
+int Font::Measure::Add(char c)
+{
+	uint8_t byte = c;
+	if(pending && (byte & 0xC0) == 0x80)
+	{
+		code = (code << 6) | (byte & 0x3F);
+		return (--pending ? 0 : AddCode(code));
+	}
+	// If a multi-byte character was cut short, it is skipped.
+	pending = 0;
+	if(byte < 0x80)
+		return AddCode(byte);
+	if(byte < 0xC0 || byte >= 0xF8)
+		return AddCode(0xFFFD);
+	
+	pending = (byte >= 0xF0 ? 3 : byte >= 0xE0 ? 2 : 1);
+	code = byte & (0x3F >> pending);
+	return 0;
+}
+
+
+
+// Add the next complete character.
+int Font::Measure::AddCode(uint32_t code)
+{
+	// Select curly quotes based on whether the most recent non-quote
+	// character was a space.
+	int next = metrics.Index(code, isAfterSpace);
+	if(code != '"' && code != '\'')
+		isAfterSpace = !next;
+	
+	if(!next)
+		width += metrics.space;
+	else
+	{
+		width += metrics.Advance(prev, next);
+		prev = next;
+	}
+	return next;
+}
+
+
+
+// Get the width of the characters added so far.
+int Font::Measure::Width() const
+{
+	// Include the advance to get to the end of the last character.
+	return width + metrics.Advance(prev);
+}
+
+
+
+// Get the x offset at which the last glyph that was added is drawn. No
+// advance is ever negative, so this is also the smallest width that any
+// string beginning with the characters added so far could have.
+int Font::Measure::Offset() const
+{
+	return width;
+}
+
+
+
+// Draw the given glyphs onto a new surface of their own, and find the
+// offset of that surface's top left corner. This fails, returning null, if
+// any glyphs overlap or do not have span masks.
+SDL_Surface *Font::Render(const vector<Glyph> &text, Point &offset)
+{
+	// All the glyphs must come from sheets in the same format, which
+	// Prepare() has converted so that they have span masks.
+	const SDL_PixelFormat *format = text.front().font->metrics.Sheet(text.front().index)->format;
+	for(const Glyph &glyph : text)
+	{
+		const Metrics &metrics = glyph.font->metrics;
+		if(!metrics.Mask(glyph.index).IsValid() || metrics.Sheet(glyph.index)->format->format != format->format)
+			return nullptr;
+	}
+	Rect bounds = Bounds(text);
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, bounds.w, bounds.h, 32, format->format);
+	if(!surface)
+		return nullptr;
+	SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_BLEND);
+	
+	// Copy the glyphs' pixels in each font's color, skipping transparent ones,
+	// which blending would leave unchanged. If two glyphs cover the same pixel,
+	// blending them one after the other could give a different color, so give
+	// up.
+	uint32_t alpha = format->Amask;
+	int pitch = surface->pitch / 4;
+	uint32_t *pixels = reinterpret_cast<uint32_t *>(surface->pixels);
+	for(const Glyph &glyph : text)
+	{
+		const SDL_Surface *sheet = glyph.font->metrics.Sheet(glyph.index);
+		const Rect &box = glyph.font->metrics.Box(glyph.index);
+		uint32_t rgb = glyph.font->color(surface) & ~alpha;
+		int sheetPitch = sheet->pitch / 4;
+		const uint32_t *in = reinterpret_cast<const uint32_t *>(sheet->pixels) + box.y * sheetPitch + box.x;
+		Point corner = glyph.point - bounds.TopLeft();
+		uint32_t *out = pixels + corner.Y() * pitch + corner.X();
+		for(int y = 0; y < box.h; ++y, in += sheetPitch, out += pitch)
+			for(int x = 0; x < box.w; ++x)
+			{
+				if(!(in[x] & alpha))
+					continue;
+				if(out[x] & alpha)
+				{
+					SDL_FreeSurface(surface);
+					return nullptr;
+				}
+				out[x] = (in[x] & alpha) | rgb;
+			}
+	}
+	offset = bounds.TopLeft();
+	return surface;
+}
+
+
+
+// Get the rectangle that the given glyphs cover.
+Rect Font::Bounds(const vector<Glyph> &text)
+{
+	Rect bounds;
+	for(const Glyph &glyph : text)
+	{
+		Rect rect(glyph.point, glyph.point + glyph.font->metrics.Box(glyph.index).Size());
+		if(&glyph == &text.front())
+			bounds = rect;
+		else
+			SDL_UnionRect(&bounds, &rect, &bounds);
+	}
+	return bounds;
+}
+
+
+
+// Construct a font with the given metrics and color:
+Font::Font(const string &path, Metrics &metrics, const Color &color)
+	: metrics(metrics), color(color)
+{
+	// The first font to use a given source image loads it. The others just
+	// draw the same sheet in their own colors.
+	if(!metrics.base.glyphs)
+		metrics.Init(path);
 }
 
 
@@ -336,8 +858,8 @@ namespace {
 		return path;
 	}
 	
-	// Map a character to a glyph index.
-	int Glyph(char c, bool isAfterSpace)
+	// Map an ASCII character to a glyph index.
+	int GlyphIndex(char c, bool isAfterSpace)
 	{
 		// Curly quotes.
 		if(c == '\'' && isAfterSpace)
@@ -347,4 +869,221 @@ namespace {
 		
 		return max(0, min(Font::Metrics::GLYPHS - 3, c - 32));
 	}
+	
+	// Decode the UTF-8 character that starts at the given position. Anything
+	// that is not valid UTF-8 is decoded as the replacement character.
+	uint32_t Decode(const char *it, const char *end)
+	{
+		uint8_t byte = *it;
+		if(byte < 0x80)
+			return byte;
+		if(byte < 0xC0 || byte >= 0xF8)
+			return 0xFFFD;
+		
+		int pending = (byte >= 0xF0 ? 3 : byte >= 0xE0 ? 2 : 1);
+		uint32_t code = byte & (0x3F >> pending);
+		for( ; pending; --pending)
+		{
+			if(++it == end || (*it & 0xC0) != 0x80)
+				return 0xFFFD;
+			code = (code << 6) | (*it & 0x3F);
+		}
+		return code;
+	}
+	
+	// Load a glyph sheet, in a 32-bit format.
+	SDL_Surface *LoadSheet(const string &path)
+	{
+		SDL_Surface *sheet = Bundle::LoadImage(path);
+		if(!sheet || sheet->format->BytesPerPixel == 4)
+			return sheet;
+		
+		SDL_Surface *converted = SDL_ConvertSurfaceFormat(sheet, SDL_PIXELFORMAT_ARGB8888, 0);
+		SDL_FreeSurface(sheet);
+		return converted;
+	}
+	
+	// Get the path of the given page of glyphs for the font with the given
+	// main sheet.
+	string PagePath(const string &path, uint32_t number)
+	{
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "-u%02x.png", number);
+		return path.substr(0, path.rfind('.')) + suffix;
+	}
+	
+	// Get the path of the cached kerning for the given main sheet.
+	string KerningPath(const string &path)
+	{
+		return path.substr(0, path.rfind('.')) + ".kern";
+	}
+	
+	// Get the names of all the files in the given directory, in sorted order.
+	vector<string> ListDirectory(const string &path)
+	{
+		vector<string> names;
+		DIR *dir = opendir(path.empty() ? "." : path.c_str());
+		if(!dir)
+			return names;
+		
+		while(const dirent *entry = readdir(dir))
+			names.emplace_back(entry->d_name);
+		closedir(dir);
+		sort(names.begin(), names.end());
+		return names;
+	}
+	
+	// Get the advance for the given two glyphs, from the right edges of the
+	// previous one and the left edges of the next one. If there is no next
+	// glyph, i.e. this is the end of a line of text, the advance is the full
+	// width of the previous one.
+	int FindAdvance(const int *right, const int *left, int height)
+	{
+		int glyphWidth = *max_element(right, right + height);
+		if(!left)
+			return KERN + glyphWidth;
+		
+		// How far apart do you want these glyphs drawn? If drawn at an
+		// advance of "width", there would be width - right pixels after the
+		// previous glyph and left - 1 pixels before the next one. So for zero
+		// kerning distance, you would want right + 1 - left.
+		int maxD = 0;
+		for(int y = 0; y < height; ++y)
+			maxD = max(maxD, right[y] + 1 - left[y]);
+		// This is a fudge factor to avoid over-kerning, especially for the
+		// underscore and for glyph combinations like AV.
+		return KERN + max(maxD, glyphWidth - 4);
+	}
+	
+	// Fill in the advance table for the main glyph sheet, from the edges of
+	// its glyphs.
+	void FindKerning(const Font::Metrics::Page &page, int height, int *advance)
+	{
+		Trace::Span span("FindKerning");
+		const int GLYPHS = Font::Metrics::GLYPHS;
+		
+		// advance[previous * GLYPHS + next] is the x advance for each glyph
+		// pair. There is no advance if the previous value is 0, i.e. we are
+		// at the very start of a string. The rows of the table are split up
+		// between threads.
+		memset(advance, 0, GLYPHS * sizeof(advance[0]));
+		int threads = max(1, min(GLYPHS, static_cast<int>(thread::hardware_concurrency())));
+		auto fill = [&](int firstPrev)
+		{
+			for(int prev = firstPrev; prev < GLYPHS; prev += threads)
+			{
+				const int *pit = &page.right[prev * height];
+				advance[prev * GLYPHS] = FindAdvance(pit, nullptr, height);
+				for(int next = 1; next < GLYPHS; ++next)
+					advance[prev * GLYPHS + next] = FindAdvance(pit, &page.left[next * height], height);
+			}
+		};
+		vector<thread> workers;
+		for(int i = 2; i <= threads; ++i)
+			workers.emplace_back(fill, i);
+		fill(1);
+		for(thread &worker : workers)
+			worker.join();
+	}
+	
+	// Get a hash of the given glyph sheet's size and pixels, and of the
+	// settings that the advances depend on.
+	uint64_t Hash(const SDL_Surface *glyphs)
+	{
+		// This is the 64-bit FNV-1a hash.
+		uint64_t hash = 14695981039346656037ull;
+		auto add = [&hash](const void *data, size_t size)
+		{
+			const uint8_t *it = reinterpret_cast<const uint8_t *>(data);
+			for(const uint8_t *end = it + size; it != end; ++it)
+				hash = (hash ^ *it) * 1099511628211ull;
+		};
+		int header[] = {Font::Metrics::GLYPHS, KERN, glyphs->w, glyphs->h, static_cast<int>(glyphs->format->Amask)};
+		add(header, sizeof(header));
+		for(int y = 0; y < glyphs->h; ++y)
+			add(reinterpret_cast<const uint8_t *>(glyphs->pixels) + y * glyphs->pitch, glyphs->w * glyphs->format->BytesPerPixel);
+		return hash;
+	}
+	
+	// Read a cached advance table. It is only used if it was made from an
+	// image with the given hash.
+	bool LoadKerning(const string &path, uint64_t hash, int *advance)
+	{
+		// If the game was packed into a bundle, the table is in it.
+		string_view bundled = Bundle::Find(path);
+		string contents(bundled);
+		if(!bundled.data())
+		{
+			ifstream in(path, ios::binary);
+			contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+		}
+		
+		const size_t size = Font::Metrics::GLYPHS * Font::Metrics::GLYPHS;
+		uint64_t fileHash = 0;
+		if(contents.size() < sizeof(fileHash) + size * sizeof(int32_t))
+			return false;
+		memcpy(&fileHash, contents.data(), sizeof(fileHash));
+		if(fileHash != hash)
+			return false;
+		
+		vector<int32_t> table(size);
+		memcpy(table.data(), contents.data() + sizeof(fileHash), size * sizeof(int32_t));
+		copy(table.begin(), table.end(), advance);
+		return true;
+	}
+	
+	// Write an advance table to the cache. The font directory may not be
+	// writable, in which case the table is just calculated every time.
+	void SaveKerning(const string &path, uint64_t hash, const int *advance)
+	{
+		const size_t size = Font::Metrics::GLYPHS * Font::Metrics::GLYPHS;
+		vector<int32_t> table(advance, advance + size);
+		ofstream out(path, ios::binary);
+		out.write(reinterpret_cast<const char *>(&hash), sizeof(hash));
+		out.write(reinterpret_cast<const char *>(table.data()), size * sizeof(int32_t));
+	}
+	
+	Rendered::Rendered(const string &key)
+		: key(key)
+	{
+	}
+	
+	Rendered::~Rendered()
+	{
+		if(surface)
+		{
+			Compositor::Forget(surface);
+			SDL_FreeSurface(surface);
+		}
+	}
+	
+	// Get the key for caching the given glyphs. The font determines the
+	// color as well as the glyph images.
+	string CacheKey(const vector<Font::Glyph> &text)
+	{
+		string key;
+		key.reserve(text.size() * (sizeof(const Font *) + 3 * sizeof(int)));
+		for(const Font::Glyph &glyph : text)
+		{
+			key.append(reinterpret_cast<const char *>(&glyph.font), sizeof(glyph.font));
+			int values[3] = {glyph.index, glyph.point.X(), glyph.point.Y()};
+			key.append(reinterpret_cast<const char *>(values), sizeof(values));
+		}
+		return key;
+	}
+	
+	// Check if the given cache entry can be freed now. If the compositor is
+	// recording, anything drawn in this frame must be kept until it is done.
+	bool IsUnused(const Rendered &entry)
+	{
+		return (!Compositor::IsEnabled() || entry.frame != Compositor::Frames());
+	}
+	
+	// Free the least recently used cache entry.
+	void Evict()
+	{
+		cacheMemory -= cache.back().bytes;
+		cacheIndex.erase(cache.back().key);
+		cache.pop_back();
+	}
 }
@@ -5,6 +5,7 @@ Copyright 2020 Michael Zahniser
 #ifndef FONT_H_
 #define FONT_H_
 
+#include "Blitter.h"
 #include "Color.h"
 #include "Data.h"
 #include "Point.h"
@@ -12,7 +13,10 @@ Copyright 2020 Michael Zahniser
 
 #include <SDL2/SDL.h>
 
+#include <cstdint>
+#include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -31,21 +35,58 @@ public:
 	// Get the font for the named style. If no such style is defined or if the
 	// style is an empty string, this returns the default font.
 	static const Font &Get(const string &name = "");
+	// Convert the glyph sheets to an alpha format matching the given pixel
+	// format (normally that of the window surface), and build a span mask for
+	// each glyph. If the masks can't be used for that format, the sheets use
+	// RLE acceleration instead, unless the compositor is enabled.
+	static void Prepare(const SDL_PixelFormat *format);
 	// Free all the glyph sheets.
 	static void FreeAll();
+	// Get the memory used by all the glyph sheets.
+	static size_t Memory();
+	// Get the paths of all the files that the loaded fonts are drawn from,
+	// including pages of glyphs that have not been loaded yet.
+	static vector<string> Files();
+	
+	// One glyph of laid-out text: the font it is drawn in, which glyph it is,
+	// and where its top left corner is. The index can be passed to that font's
+	// Metrics to find the glyph's sheet, box, and mask. Fonts are not moved
+	// once they are loaded, so the pointer is valid until FreeAll() is called.
+	class Glyph {
+	public:
+		const Font *font;
+		int index;
+		Point point;
+	};
+	// Draw the given glyphs, offset by the given amount.
+	static void Draw(const vector<Glyph> &text, Point corner, SDL_Surface *surface);
+	// Draw the given glyphs the same way, but with a single blit of a surface
+	// that they have already been drawn onto. Those surfaces are kept in a
+	// least recently used cache, so this is for text that is drawn over and
+	// over without changing, like menus and dialog text.
+	static void DrawCached(const vector<Glyph> &text, Point corner, SDL_Surface *surface);
+	// Set the most memory, in bytes, that the cached text may use. If this is
+	// 0, nothing is cached.
+	static void SetCacheSize(size_t bytes);
+	// Get the memory, in bytes, that the cached text is using now.
+	static size_t CacheMemory();
 	
 	
 public:
-	// Destructor.
-	~Font();
-	// Draw the given string, with its top left corner at the given (x, y).
+	// Draw the given UTF-8 string, with its top left corner at the given (x, y).
 	void Draw(const string &text, Point point, SDL_Surface *surface) const;
+	// Lay out the given string with its top left corner at the given point, and
+	// add its glyphs to the given list.
+	void Layout(const string &text, Point point, vector<Glyph> &glyphs) const;
 	
 	// Get the width of the given string.
 	int Width(const string &text) const;
+	// Get the height of the glyphs.
+	int Height() const;
 	// Get the kerning adjustment for when the given first string is followed by
 	// the given second string.
 	int Kern(const string &first, const string &second) const;
+	int Kern(const string &first, const char *begin, const char *end) const;
 	
 	
 public:
@@ -53,28 +94,102 @@ public:
 	// can be used in helper functions in the implementation code.
 	// TODO: find a less messy way of accomplishing that.
 	class Metrics {
+	public:
+		// One glyph sheet, and the size and shape of each glyph in it.
+		class Page {
+		public:
+			// Take ownership of the given sheet, which is divided into the given
+			// number of glyphs, and measure them.
+			void Init(SDL_Surface *sheet, int count);
+			// Convert the sheet to the format that Font::Prepare() chose, if
+			// it has been called, and build the span masks.
+			void Prepare();
+			
+			// The glyph sheet. The glyphs are white, and each font draws them in
+			// its own color. This is null if the page's image does not exist.
+			SDL_Surface *glyphs = nullptr;
+			// Bounding box of each glyph.
+			vector<Rect> box;
+			// Span mask of each glyph. All colors of a font have the same
+			// alpha, so they can all share these.
+			vector<Blitter> mask;
+			// Edges of each glyph in each row, for kerning: left[g * height + y]
+			// is one more than the position of glyph g's first non-empty pixel in
+			// row y, or the glyph width, and right[g * height + y] is one more
+			// than the position of its last non-empty pixel, or 1.
+			vector<int> left;
+			vector<int> right;
+		};
+		
 	public:
 		// Load the glyph sheet for fonts with these metrics.
 		SDL_Surface *Init(const string &path);
 		
+		// Get the glyph index for the given Unicode code point, loading the
+		// page that it is on if this is the first time it has been used.
+		int Index(uint32_t code, bool isAfterSpace);
 		// Get the advance between the given two glyph indices.
 		int Advance(int prev, int next = 0) const;
+		// Get the sheet, bounding box, and span mask of the given glyph.
+		SDL_Surface *Sheet(int index) const;
+		const Rect &Box(int index) const;
+		const Blitter &Mask(int index) const;
 		
-		// Pointer to the first glyph sheet for a font with these metrics.
-		// Multiple fonts may use copies of this sheet with different colors.
-		SDL_Surface *glyphs = nullptr;
-		// Skip characters 0..31 and characters 127...255.
-		// That leaves 128 - 32 - 1 = 95 characters, plus one more
-		// glyph for any characters outside that range. Add two more glyphs for
-		// right-side single and double quotes.
+		// The main sheet has characters 32...126, plus one more glyph for any
+		// character that no sheet has. Add two more glyphs for left-side single
+		// and double quotes. The straight quotes are drawn as right-side ones.
 		static const int GLYPHS = 98;
-		// Kerning between any two glyphs: advance[a + b * GLYPHS] is the advance
-		// for glyph a followed by glyph b.
+		// Every other character is on a page of 256 code points, which is
+		// loaded from its own sheet the first time one of them is drawn or
+		// measured. Glyph index GLYPHS + c is code point c.
+		static const int PAGE_SIZE = 256;
+		// The main sheet, and every page that has been looked for so far.
+		Page base;
+		map<uint32_t, Page> pages;
+		// Path to the main sheet. The other pages are in files beside it.
+		string path;
+		// Kerning between any two glyphs on the main sheet: advance[a * GLYPHS
+		// + b] is the advance for glyph a followed by glyph b. Glyphs on other
+		// pages are kerned the same way, but only when they are used.
 		int advance[GLYPHS * GLYPHS];
-		// Bounding box of each glyph.
-		Rect box[GLYPHS];
 		// This value will be adjusted based on the character height.
 		int space;
+		
+	private:
+		// Get the page that the given glyph is on, and its position on it.
+		const Page &Find(int index, int &slot) const;
+	};
+	
+	// Measure a string one character at a time, exactly the way Width() does,
+	// so that the width of every prefix of a string can be found in one pass.
+	class Measure {
+	public:
+		explicit Measure(const Font &font);
+		
+		// Add the next byte of a UTF-8 string, and return the glyph index of
+		// the character that it completes. Spaces and other blank characters
+		// have no glyph, and neither do the leading bytes of a multi-byte
+		// character, so the index is 0.
+		int Add(char c);
+		// Get the width of the characters added so far.
+		int Width() const;
+		// Get the x offset at which the last glyph that was added is drawn.
+		// No advance is ever negative, so this is also the smallest width that
+		// any string beginning with the characters added so far could have.
+		int Offset() const;
+		
+	private:
+		// Add the next complete character.
+		int AddCode(uint32_t code);
+		
+	private:
+		Metrics &metrics;
+		int width = 0;
+		int prev = 0;
+		bool isAfterSpace = true;
+		// The character being decoded, and how many more bytes it needs.
+		uint32_t code = 0;
+		int pending = 0;
 	};
 	
 	
@@ -83,11 +198,21 @@ public:
 	Font(const string &path, Metrics &metrics, const Color &color);
 	
 	
+private:
+	// Draw the given glyphs onto a new surface of their own, and find the
+	// offset of that surface's top left corner. This fails, returning null, if
+	// any glyphs overlap or do not have span masks.
+	static SDL_Surface *Render(const vector<Glyph> &text, Point &offset);
+	// Get the rectangle that the given glyphs cover.
+	static Rect Bounds(const vector<Glyph> &text);
+	
+	
 private:
 	// Each Font object has its own color, but all different colors of a given
-	// font share the same metrics.
-	const Metrics &metrics;
-	SDL_Surface *glyphs = nullptr;
+	// font share the same metrics and glyph sheets. Measuring text may load
+	// more pages of glyphs, so the metrics are not const.
+	Metrics &metrics;
+	Color color;
 };
 
 
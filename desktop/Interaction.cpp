@@ -17,9 +17,9 @@ namespace {
 		// (point.x / radius.x)^2 + (point.y / radius.y)^2 < 1
 		// (point.x * radius.y)^2 + (point.y * radius.x)^2 < (radius.x * radius.y)^2
 		// Use 64-bit math to avoid overflow.
-		int64_t px = point.X() * radius.Y();
-		int64_t py = point.Y() * radius.X();
-		int64_t r = radius.X() * radius.Y();
+		int64_t px = static_cast<int64_t>(point.X()) * radius.Y();
+		int64_t py = static_cast<int64_t>(point.Y()) * radius.X();
+		int64_t r = static_cast<int64_t>(radius.X()) * radius.Y();
 		return (px * px + py * py <= r * r);
 	}
 };
@@ -41,37 +41,40 @@ void Interaction::Load(Data &data)
 	name = data.Value();
 	while(data.Next() && data.Size())
 	{
-		if(data.Tag() == "position")
-			position = data[1];
-		else if(data.Tag() == "offset")
-			offset = data[1];
-		else if(data.Tag() == "visible")
+		switch(data.Key())
 		{
-			radius[VISIBLE] = data[1];
-			icon[VISIBLE] = data[2];
+			case Data::POSITION:
+				position = data[1];
+				break;
+			case Data::OFFSET:
+				offset = data[1];
+				break;
+			case Data::VISIBLE:
+				radius[VISIBLE] = data[1];
+				icon[VISIBLE] = data[2];
+				break;
+			case Data::ACTIVE:
+				radius[ACTIVE] = data[1];
+				icon[ACTIVE] = data[2];
+				icon[HOVER] = data[3];
+				// If no hover icon is provided, use the active icon.
+				if(!icon[HOVER])
+					icon[HOVER] = icon[ACTIVE];
+				break;
+			case Data::ENTER:
+				hasEnter = true;
+				enterPosition = data[1];
+				enterRoom = data.Value(2);
+				break;
+			case Data::DIALOG:
+				dialog = data.Value();
+				break;
+			// If the tag is none of the above, we have reached the end of this
+			// interaction definition. The next interaction, or some other room
+			// data, may begin immediately without a blank line.
+			default:
+				return;
 		}
-		else if(data.Tag() == "active")
-		{
-			radius[ACTIVE] = data[1];
-			icon[ACTIVE] = data[2];
-			icon[HOVER] = data[3];
-			// If no hover icon is provided, use the active icon.
-			if(!icon[HOVER])
-				icon[HOVER] = icon[ACTIVE];
-		}
-		else if(data.Tag() == "enter")
-		{
-			hasEnter = true;
-			enterPosition = data[1];
-			enterRoom = data.Value(2);
-		}
-		else if(data.Tag() == "dialog")
-			dialog = data.Value();
-		// If the tag is none of the above, we have reached the end of this
-		// interaction definition. The next interaction, or some other room
-		// data, may begin immediately without a blank line.
-		else
-			break;
 	}
 }
 
@@ -4,10 +4,12 @@ Copyright 2020 Michael Zahniser
 
 #include "Menu.h"
 
+#include "Compositor.h"
 #include "Font.h"
 #include "Sprite.h"
 
 #include <map>
+#include <vector>
 
 using namespace std;
 
@@ -27,12 +29,18 @@ void Menu::Add(Data &data)
 	menu.name = data.Value();
 	while(data.Next() && data.Size())
 	{
-		if(data.Tag() == "background")
-			menu.background = Color(data[1], data[2], data[3]);
-		else if(data.Tag() == "style")
-			style = data.Value();
-		else
-			menu.items.emplace_back(data, style);
+		switch(data.Key())
+		{
+			case Data::BACKGROUND:
+				menu.background = Color(data[1], data[2], data[3]);
+				break;
+			case Data::STYLE:
+				style = data.Value();
+				break;
+			default:
+				menu.items.emplace_back(data, style);
+				break;
+		}
 	}
 	// Remember whether this menu has buttons.
 	for(const Item &item : menu.items)
@@ -56,14 +64,16 @@ void Menu::Draw(SDL_Surface *screen, Point hover, bool loaded) const
 	// Menu coordinates are relative to the center of the screen, so that the
 	// menu will be centered in large screens.
 	center = Point(screen->w / 2, screen->h / 2);
-	SDL_FillRect(screen, nullptr, background(screen));
+	Compositor::Fill(screen, nullptr, background(screen));
 	for(const Item &item : items)
 	{
 		Point pos = center + item.center;
 		if(!item.text.empty())
 		{
-			const Font &font = Font::Get(item.style);
-			font.Draw(item.text, pos, screen);
+			// Menu text never changes, so it is drawn from the text cache.
+			vector<Font::Glyph> glyphs;
+			Font::Get(item.style).Layout(item.text, Point(), glyphs);
+			Font::DrawCached(glyphs, pos, screen);
 		}
 		else
 		{
@@ -129,6 +139,19 @@ const string &Menu::Handle(const SDL_Event &event) const
 
 
 
+// Check if any of this menu's sprites are animated, i.e. whether it looks
+// different after each Sprite::Step().
+bool Menu::IsAnimated() const
+{
+	for(const Item &item : items)
+		for(int sprite : item.sprites)
+			if(Sprite::Get(sprite).IsAnimated())
+				return true;
+	return false;
+}
+
+
+
 // Check if the given point is inside a button. If so, return it.
 const Menu::Item *Menu::Button(Point point) const
 {
@@ -35,6 +35,9 @@ public:
 	// "quit" means quit the game.
 	// Any other string means to switch to the menu with that name.
 	const string &Handle(const SDL_Event &event) const;
+	// Check if any of this menu's sprites are animated, i.e. whether it looks
+	// different after each Sprite::Step().
+	bool IsAnimated() const;
 	
 	
 private:
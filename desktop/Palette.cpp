@@ -33,36 +33,39 @@ void Palette::Load(const string &path)
 	bool includeSheet = false;
 	for(Data data(path); data; data.Next())
 	{
-		if(data.Tag() == "index")
+		switch(data.Key())
 		{
-			includeSheet = (static_cast<int>(data[1]) >= 1000);
-			Sprite::SetIndex(data);
-		}
-		else if(data.Tag() == "sheet")
-		{
-			if(includeSheet)
+			case Data::INDEX:
+				includeSheet = (static_cast<int>(data[1]) >= 1000);
+				Sprite::SetIndex(data);
+				break;
+			case Data::SHEET:
+				if(includeSheet)
+				{
+					string name = data.Value();
+					name = name.substr(name.rfind('/') + 1);
+					name = name.substr(0, name.rfind('.'));
+					sheets.emplace_back(name);
+				}
+				
+				Sprite::LoadSheet(data);
+				break;
+			case Data::SPRITE:
 			{
-				string name = data.Value();
-				name = name.substr(name.rfind('/') + 1);
-				name = name.substr(0, name.rfind('.'));
-				sheets.emplace_back(name);
+				int index = Sprite::Add(data);
+				if(includeSheet)
+					sheets.back().sprites.emplace_back(index);
+				break;
 			}
-			
-			Sprite::LoadSheet(data);
-		}
-		else if(data.Tag() == "sprite")
-		{
-			int index = Sprite::Add(data);
-			if(includeSheet)
-				sheets.back().sprites.emplace_back(index);
-		}
-		else if(data.Tag() == "style")
-			Font::Add(data);
-		else if(data.Size())
-		{
-			// This is an unknown data block. Skip everything in it.
-			while(data.Next() && data.Size())
-				continue;
+			case Data::STYLE:
+				Font::Add(data);
+				break;
+			default:
+				// This is an unknown data block. Skip everything in it.
+				if(data.Size())
+					while(data.Next() && data.Size())
+						continue;
+				break;
 		}
 	}
 }
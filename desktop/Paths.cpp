@@ -5,6 +5,8 @@ Copyright 2020 Michael Zahniser
 #include "Paths.h"
 
 #include "Sprite.h"
+#include "Stats.h"
+#include "Trace.h"
 
 #include <cmath>
 #include <limits>
@@ -44,6 +46,8 @@ namespace {
 // pathfinding must be recalculated from scratch.)
 void Paths::Init(const Room &room, Point point)
 {
+	Trace::Span span("Paths::Init", room.Name());
+	
 	// Clear any previous pathfinding data.
 	passable.clear();
 	waypoints.clear();
@@ -87,6 +91,9 @@ void Paths::Init(const Room &room, Point point)
 // avatar's polygon, it will move to the closest vertex of the polygon.
 vector<Point> Paths::Find(Point from, Point to) const
 {
+	STATS_TIMER(PATHS);
+	Trace::Span span("Paths::Find");
+	
 	// If for some reason we have no mask, bail out.
 	if(passable.empty())
 		return vector<Point>();
@@ -215,13 +222,13 @@ void Paths::AddWaypoint(Point vertex, Point back, Point forward)
 // Find the closest passable vertex to the given point.
 Point Paths::ClosestVertex(Point target) const
 {
-	int bestDistance = numeric_limits<int>::max();
+	Point::Product bestDistance = numeric_limits<Point::Product>::max();
 	Point bestPoint;
 	
 	for(const Ring &part : passable)
 		for(const Point &point : part)
 		{
-			int distance = target.DistanceSquared(point);
+			Point::Product distance = target.DistanceSquared(point);
 			if(distance < bestDistance)
 			{
 				bestDistance = distance;
@@ -8,160 +8,25 @@ Copyright 2020 Michael Zahniser
 
 using namespace std;
 
-
-
-Point::Point(int x, int y)
-	: x(x), y(y)
-{
-}
-
-
-
-// Check if this point is something other than (0, 0).
-Point::operator bool() const
-{
-	return (x || y);
-}
-
-
-
-bool Point::operator!() const
-{
-	return !(x || y);
-}
-
-
-
-bool Point::operator==(Point p) const
-{
-	return (x == p.x && y == p.y);
-}
-
-
-
-bool Point::operator!=(Point p) const
-{
-	return (x != p.x || y != p.y);
-}
-
-
-
-Point Point::operator+(Point p) const
-{
-	return Point(x + p.x, y + p.y);
-}
-
-
-
-Point &Point::operator+=(Point p)
-{
-	x += p.x;
-	y += p.y;
-	return *this;
-}
-
-
-
-Point Point::operator-(Point p) const
-{
-	return Point(x - p.x, y - p.y);
-}
-
-
-
-Point &Point::operator-=(Point p)
-{
-	x -= p.x;
-	y -= p.y;
-	return *this;
-}
-
-
-
-Point Point::operator-() const
-{
-	return Point(-x, -y);
-}
-
-
-
-Point Point::operator*(int s) const
-{
-	return Point(x * s, y * s);
-}
-
-
-
-Point &Point::operator*=(int s)
-{
-	x *= s;
-	y *= s;
-	return *this;
-}
-
-
-
-Point operator*(int s, Point p)
-{
-	return Point(p.x * s, p.y * s);
-}
-
-
-
-Point Point::operator/(int s) const
-{
-	return Point(x / s, y / s);
-}
-
-
-
-Point &Point::operator/=(int s)
-{
-	x /= s;
-	y /= s;
-	return *this;
-}
-
-
-
-int &Point::X()
-{
-	return x;
-}
-
-
-
-int Point::X() const
-{
-	return x;
-}
-
-
-
-int &Point::Y()
-{
-	return y;
-}
-
-
-
-int Point::Y() const
-{
-	return y;
-}
-
-
-
-int Point::Dot(Point p) const
-{
-	return x * p.x + y * p.y;
-}
-
-
-
-int Point::Cross(Point p) const
-{
-	return x * p.y - y * p.x;
+namespace {
+	// Compile-time tests of the inline Point functions.
+	static_assert(Point(1, 2) + Point(3, 4) == Point(4, 6));
+	static_assert(Point(1, 2) - Point(3, 4) == Point(-2, -2));
+	static_assert(-Point(1, -2) == Point(-1, 2));
+	static_assert(Point(1, 2) * 3 == Point(3, 6) && 3 * Point(1, 2) == Point(3, 6));
+	static_assert(Point(7, -7) / 2 == Point(3, -3));
+	static_assert(Point(1, 2) != Point(2, 1));
+	static_assert(!Point() && Point(0, 1) && Point(1, 0));
+	static_assert(Point(1, 2).Dot(Point(3, 4)) == 11);
+	static_assert(Point(1, 0).Cross(Point(0, 1)) == 1 && Point(0, 1).Cross(Point(1, 0)) == -1);
+	static_assert(Point(3, 4).LengthSquared() == 25);
+	static_assert(Point(1, 1).DistanceSquared(Point(4, 5)) == 25);
+	static_assert([]() { Point p(1, 2); p += Point(1, 1); p *= 2; p -= Point(1, 1); p /= 2; return p; }() == Point(1, 2));
+	static_assert([]() { Point p; p.X() = 5; p.Y() = -5; return p; }() == Point(5, -5));
+#ifdef WIDE_GEOMETRY
+	// Make sure that products of large coordinates do not overflow.
+	static_assert(Point(100000, 0).Cross(Point(0, 100000)) == 10000000000);
+#endif
 }
 
 
@@ -173,21 +38,7 @@ float Point::Length() const
 
 
 
-int Point::LengthSquared() const
-{
-	return Dot(*this);
-}
-
-
-
 float Point::Distance(Point p) const
 {
 	return (p - *this).Length();
 }
-
-
-
-int Point::DistanceSquared(Point p) const
-{
-	return (p - *this).LengthSquared();
-}
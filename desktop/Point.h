@@ -5,47 +5,64 @@ Copyright 2020 Michael Zahniser
 #ifndef POINT_H_
 #define POINT_H_
 
+#include <cstdint>
+
 using namespace std;
 
 
 
+// Point is used in the innermost loops of the polygon and pathfinding code, so
+// everything that does not need the math library is defined in this header
+// where it can be inlined, and is constexpr so it can be tested at compile time.
 class Point {
 public:
-	Point(int x = 0, int y = 0);
+	// Dot products, cross products, and squared lengths are calculated using
+	// this type. By default it is a plain int, which is fastest but overflows
+	// once coordinates exceed roughly 20,000. Define WIDE_GEOMETRY to use 64-bit
+	// intermediate values instead, e.g. for very large rooms.
+#ifdef WIDE_GEOMETRY
+	typedef int64_t Product;
+#else
+	typedef int Product;
+#endif
+	
+	
+public:
+	constexpr Point(int x = 0, int y = 0);
 	
 	// Check if this point is something other than (0, 0).
-	operator bool() const;
-	bool operator!() const;
+	constexpr operator bool() const;
+	constexpr bool operator!() const;
 	
-	bool operator==(Point p) const;
-	bool operator!=(Point p) const;
+	constexpr bool operator==(Point p) const;
+	constexpr bool operator!=(Point p) const;
 	
-	Point operator+(Point p) const;
-	Point &operator+=(Point p);
-	Point operator-(Point p) const;
-	Point &operator-=(Point p);
+	constexpr Point operator+(Point p) const;
+	constexpr Point &operator+=(Point p);
+	constexpr Point operator-(Point p) const;
+	constexpr Point &operator-=(Point p);
 	
-	Point operator-() const;
+	constexpr Point operator-() const;
 	
-	Point operator*(int s) const;
-	Point &operator*=(int s);
-	friend Point operator*(int s, Point p);
-	Point operator/(int s) const;
-	Point &operator/=(int s);
+	constexpr Point operator*(int s) const;
+	constexpr Point &operator*=(int s);
+	friend constexpr Point operator*(int s, Point p);
+	constexpr Point operator/(int s) const;
+	constexpr Point &operator/=(int s);
 	
 	// Allow setting X and Y directly on non-const Points.
-	int &X();
-	int X() const;
-	int &Y();
-	int Y() const;
+	constexpr int &X();
+	constexpr int X() const;
+	constexpr int &Y();
+	constexpr int Y() const;
 	
-	int Dot(Point p) const;
-	int Cross(Point p) const;
+	constexpr Product Dot(Point p) const;
+	constexpr Product Cross(Point p) const;
 	
 	float Length() const;
-	int LengthSquared() const;
+	constexpr Product LengthSquared() const;
 	float Distance(Point p) const;
-	int DistanceSquared(Point p) const;
+	constexpr Product DistanceSquared(Point p) const;
 	
 	
 private:
@@ -55,4 +72,174 @@ private:
 
 
 
+constexpr Point::Point(int x, int y)
+	: x(x), y(y)
+{
+}
+
+
+
+// Check if this point is something other than (0, 0).
+constexpr Point::operator bool() const
+{
+	return (x || y);
+}
+
+
+
+constexpr bool Point::operator!() const
+{
+	return !(x || y);
+}
+
+
+
+constexpr bool Point::operator==(Point p) const
+{
+	return (x == p.x && y == p.y);
+}
+
+
+
+constexpr bool Point::operator!=(Point p) const
+{
+	return (x != p.x || y != p.y);
+}
+
+
+
+constexpr Point Point::operator+(Point p) const
+{
+	return Point(x + p.x, y + p.y);
+}
+
+
+
+constexpr Point &Point::operator+=(Point p)
+{
+	x += p.x;
+	y += p.y;
+	return *this;
+}
+
+
+
+constexpr Point Point::operator-(Point p) const
+{
+	return Point(x - p.x, y - p.y);
+}
+
+
+
+constexpr Point &Point::operator-=(Point p)
+{
+	x -= p.x;
+	y -= p.y;
+	return *this;
+}
+
+
+
+constexpr Point Point::operator-() const
+{
+	return Point(-x, -y);
+}
+
+
+
+constexpr Point Point::operator*(int s) const
+{
+	return Point(x * s, y * s);
+}
+
+
+
+constexpr Point &Point::operator*=(int s)
+{
+	x *= s;
+	y *= s;
+	return *this;
+}
+
+
+
+constexpr Point operator*(int s, Point p)
+{
+	return Point(p.x * s, p.y * s);
+}
+
+
+
+constexpr Point Point::operator/(int s) const
+{
+	return Point(x / s, y / s);
+}
+
+
+
+constexpr Point &Point::operator/=(int s)
+{
+	x /= s;
+	y /= s;
+	return *this;
+}
+
+
+
+constexpr int &Point::X()
+{
+	return x;
+}
+
+
+
+constexpr int Point::X() const
+{
+	return x;
+}
+
+
+
+constexpr int &Point::Y()
+{
+	return y;
+}
+
+
+
+constexpr int Point::Y() const
+{
+	return y;
+}
+
+
+
+constexpr Point::Product Point::Dot(Point p) const
+{
+	return static_cast<Product>(x) * p.x + static_cast<Product>(y) * p.y;
+}
+
+
+
+constexpr Point::Product Point::Cross(Point p) const
+{
+	return static_cast<Product>(x) * p.y - static_cast<Product>(y) * p.x;
+}
+
+
+
+constexpr Point::Product Point::LengthSquared() const
+{
+	return Dot(*this);
+}
+
+
+
+constexpr Point::Product Point::DistanceSquared(Point p) const
+{
+	return (p - *this).LengthSquared();
+}
+
+
+
 #endif
@@ -14,7 +14,7 @@ using namespace std;
 
 namespace {
 	// Get the maximum possible order value for a given ring.
-	int MaxOrder(const Ring &ring)
+	Point::Product MaxOrder(const Ring &ring)
 	{
 		Edge edge(ring);
 		while(edge)
@@ -27,7 +27,7 @@ namespace {
 	class Intersection {
 	public:
 		Intersection() = default;
-		Intersection(Point point, int order, int index = 0, bool entering = false)
+		Intersection(Point point, Point::Product order, Point::Product index = 0, bool entering = false)
 			: point(point), order(order), index(index), entering(entering) {}
 		
 		// Comparison operator, which will sort intersections by order.
@@ -36,10 +36,11 @@ namespace {
 		// Coordinates of the intersection.
 		Point point;
 		// A distance value to be used to sort intersections on the same edge.
-		int order;
+		Point::Product order;
 		// The index of the associated vertex: the source vertex, if this is in
-		// the first algorithm stage, or the link, in the second stage.
-		int index;
+		// the first algorithm stage, or the link, in the second stage. (In the
+		// first stage this stores an order value, so it must be just as wide.)
+		Point::Product index;
 		// Whether P is entering Q (as opposed to exiting it) at this point.
 		bool entering;
 	};
@@ -66,7 +67,7 @@ namespace {
 			// remove all of them if half are entering and half are not, or
 			// all but one of them if all or none of them are entering.
 			// This gets rid of corners that touch an edge without crossing it.
-			int order = intersections[i].order;
+			Point::Product order = intersections[i].order;
 			int entering = intersections[i].entering;
 			int total = 1;
 			for(++i; i < intersections.size() && intersections[i].order == order; ++i)
@@ -188,7 +189,7 @@ void Polygon::Add(const Ring &ring)
 	// Remember all intersections with all edges on Q, so we can slot them in
 	// at the right spots when generating the new Q.
 	vector<Intersection> qIntersections;
-	int qMaxOrder = MaxOrder(ring);
+	Point::Product qMaxOrder = MaxOrder(ring);
 	
 	// This is all the parts in one vector, with intersection vertices added
 	// and links between polygons (including joining end to start points).
@@ -212,20 +213,20 @@ void Polygon::Add(const Ring &ring)
 		// First, find any potential intersections. It's possible that we will
 		// generate duplicates here, e.g. if an intersection occurs at a vertex.
 		vector<Intersection> pIntersections;
-		int pMaxOrder = MaxOrder(part);
+		Point::Product pMaxOrder = MaxOrder(part);
 		
 		for(Edge p(part); p; ++p)
 			for(Edge q(ring); q; ++q)
 			{
-				int cross = p.Vector().Cross(q.Vector());
+				Point::Product cross = p.Vector().Cross(q.Vector());
 				if(!cross)
 					continue;
 				
 				// Now, we know the two lines are not parallel, so they must
 				// intersect. Calculate where that intersection occurs.
 				Point d = q.Start() - p.Start();
-				int pT = d.Cross(q.Vector());
-				int qT = d.Cross(p.Vector());
+				Point::Product pT = d.Cross(q.Vector());
+				Point::Product qT = d.Cross(p.Vector());
 				// If the cross product is negative, negate all three so that
 				// the comparisons below will work correctly.
 				bool entering = (cross > 0) ^ isHole;
@@ -514,15 +515,15 @@ bool Polygon::Intersects(Point start, Point end) const
 	for(const Ring &part : *this)
 		for(Edge p(part); p; ++p)
 		{
-			int cross = p.Vector().Cross(qV);
+			Point::Product cross = p.Vector().Cross(qV);
 			if(!cross)
 				continue;
 			
 			// Now, we know the two lines are not parallel, so they must
 			// intersect. Calculate where that intersection occurs.
 			Point d = start - p.Start();
-			int pT = d.Cross(qV);
-			int qT = d.Cross(p.Vector());
+			Point::Product pT = d.Cross(qV);
+			Point::Product qT = d.Cross(p.Vector());
 			// If the cross product is negative, negate all three so that
 			// the comparisons below will work correctly.
 			if(cross < 0)
@@ -4,102 +4,22 @@ Copyright 2020 Michael Zahniser
 
 #include "Rect.h"
 
-#include <algorithm>
-
 using namespace std;
 
-
-
-Rect::Rect(int x, int y, int w, int h)
-{
-	this->x = x;
-	this->y = y;
-	this->w = w;
-	this->h = h;
-}
-
-
-
-Rect::Rect(Point a, Point b)
-	: Rect(a.X(), a.Y(), b.X() - a.X(), b.Y() - a.Y())
-{
-}
-
-
-
-// Functions to shift a rectangle by a given vector.
-Rect Rect::operator+(Point point) const
-{
-	return Rect(x + point.X(), y + point.Y(), w, h);
-}
-
-
-
-Rect &Rect::operator+=(Point point)
-{
-	x += point.X();
-	y += point.Y();
-	return *this;
-}
-
-
-
-Rect Rect::operator-(Point point) const
-{
-	return Rect(x - point.X(), y - point.Y(), w, h);
-}
-
-
-
-Rect &Rect::operator-=(Point point)
-{
-	x -= point.X();
-	y -= point.Y();
-	return *this;
-}
-
-
-
-// Check if a rectangle contains a point or overlaps a rectangle.
-bool Rect::Contains(Point point) const
-{
-	int offX = point.X() - x;
-	int offY = point.Y() - y;
-	return (offX >= 0 && offX < w && offY >= 0 && offY < h);
-}
-
-
-
-bool Rect::Overlaps(const Rect &rect) const
-{
-	// Each rectangle contains some range of X coordinates and some range
-	// of Y coordinates. They overlap if both the X and Y ranges overlap.
-	return max(x, rect.x) < min(x + w, rect.x + rect.w)
-		&& max(y, rect.y) < min(y + h, rect.y + rect.h);
-}
-
-
-
-// Grow or shrink the rectangle in all directions by the given amount.
-void Rect::Grow(int distance)
-{
-	x -= distance;
-	y -= distance;
-	w += 2 * distance;
-	h += 2 * distance;
-}
-
-
-
-// Convert the corners to points.
-Point Rect::TopLeft() const
-{
-	return Point(x, y);
-}
-
-
-
-Point Rect::Size() const
-{
-	return Point(w, h);
+namespace {
+	// Compile-time tests of the inline Rect functions.
+	constexpr bool Equal(const Rect &a, const Rect &b)
+	{
+		return (a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h);
+	}
+	
+	static_assert(Equal(Rect(Point(1, 2), Point(4, 6)), Rect(1, 2, 3, 4)));
+	static_assert(Equal(Rect(1, 2, 3, 4) + Point(1, 1), Rect(2, 3, 3, 4)));
+	static_assert(Equal(Rect(1, 2, 3, 4) - Point(1, 1), Rect(0, 1, 3, 4)));
+	static_assert(Rect(0, 0, 2, 2).Contains(Point(0, 0)) && Rect(0, 0, 2, 2).Contains(Point(1, 1)));
+	static_assert(!Rect(0, 0, 2, 2).Contains(Point(2, 1)) && !Rect(0, 0, 2, 2).Contains(Point(-1, 0)));
+	static_assert(Rect(0, 0, 2, 2).Overlaps(Rect(1, 1, 2, 2)));
+	static_assert(!Rect(0, 0, 2, 2).Overlaps(Rect(2, 0, 2, 2)) && !Rect(0, 0, 2, 2).Overlaps(Rect(0, 2, 2, 2)));
+	static_assert(Rect(1, 2, 3, 4).TopLeft() == Point(1, 2) && Rect(1, 2, 3, 4).Size() == Point(3, 4));
+	static_assert(Equal([]() { Rect r(1, 1, 2, 2); r.Grow(1); r += Point(2, 2); r -= Point(1, 0); return r; }(), Rect(1, 2, 4, 4)));
 }
@@ -9,33 +9,129 @@ Copyright 2019 Michael Zahniser
 
 #include <SDL2/SDL.h>
 
+#include <algorithm>
+
 using namespace std;
 
 
 
-// This class is just an SDL_Rect wrapper that adds a constructor.
+// This class is just an SDL_Rect wrapper that adds a constructor. Like Point,
+// it is defined entirely in this header so that it can be inlined.
 class Rect : public SDL_Rect {
 public:
-	Rect(int x = 0, int y = 0, int w = 0, int h = 0);
-	Rect(Point a, Point b = Point(0, 0));
+	constexpr Rect(int x = 0, int y = 0, int w = 0, int h = 0);
+	constexpr Rect(Point a, Point b = Point(0, 0));
 	
 	// Functions to shift a rectangle by a given vector.
-	Rect operator+(Point point) const;
-	Rect &operator+=(Point point);
-	Rect operator-(Point point) const;
-	Rect &operator-=(Point point);
+	constexpr Rect operator+(Point point) const;
+	constexpr Rect &operator+=(Point point);
+	constexpr Rect operator-(Point point) const;
+	constexpr Rect &operator-=(Point point);
 	
 	// Check if a rectangle contains a point or overlaps a rectangle.
-	bool Contains(Point point) const;
-	bool Overlaps(const Rect &rect) const;
+	constexpr bool Contains(Point point) const;
+	constexpr bool Overlaps(const Rect &rect) const;
 	
 	// Grow or shrink the rectangle in all directions by the given amount.
-	void Grow(int distance);
+	constexpr void Grow(int distance);
 	// Convert the corner and dimensions to points.
-	Point TopLeft() const;
-	Point Size() const;
+	constexpr Point TopLeft() const;
+	constexpr Point Size() const;
 };
 
 
 
+constexpr Rect::Rect(int x, int y, int w, int h)
+	: SDL_Rect{x, y, w, h}
+{
+}
+
+
+
+constexpr Rect::Rect(Point a, Point b)
+	: Rect(a.X(), a.Y(), b.X() - a.X(), b.Y() - a.Y())
+{
+}
+
+
+
+// Functions to shift a rectangle by a given vector.
+constexpr Rect Rect::operator+(Point point) const
+{
+	return Rect(x + point.X(), y + point.Y(), w, h);
+}
+
+
+
+constexpr Rect &Rect::operator+=(Point point)
+{
+	x += point.X();
+	y += point.Y();
+	return *this;
+}
+
+
+
+constexpr Rect Rect::operator-(Point point) const
+{
+	return Rect(x - point.X(), y - point.Y(), w, h);
+}
+
+
+
+constexpr Rect &Rect::operator-=(Point point)
+{
+	x -= point.X();
+	y -= point.Y();
+	return *this;
+}
+
+
+
+// Check if a rectangle contains a point or overlaps a rectangle.
+constexpr bool Rect::Contains(Point point) const
+{
+	int offX = point.X() - x;
+	int offY = point.Y() - y;
+	return (offX >= 0 && offX < w && offY >= 0 && offY < h);
+}
+
+
+
+constexpr bool Rect::Overlaps(const Rect &rect) const
+{
+	// Each rectangle contains some range of X coordinates and some range
+	// of Y coordinates. They overlap if both the X and Y ranges overlap.
+	return max(x, rect.x) < min(x + w, rect.x + rect.w)
+		&& max(y, rect.y) < min(y + h, rect.y + rect.h);
+}
+
+
+
+// Grow or shrink the rectangle in all directions by the given amount.
+constexpr void Rect::Grow(int distance)
+{
+	x -= distance;
+	y -= distance;
+	w += 2 * distance;
+	h += 2 * distance;
+}
+
+
+
+// Convert the corners to points.
+constexpr Point Rect::TopLeft() const
+{
+	return Point(x, y);
+}
+
+
+
+constexpr Point Rect::Size() const
+{
+	return Point(w, h);
+}
+
+
+
 #endif
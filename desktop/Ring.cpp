@@ -194,7 +194,7 @@ pair<int, int> Ring::Winding(Point point) const
 		
 		// Update the winding number and the border count based on this
 		// cross product, which shows what side of the edge the point is on.
-		int cross = edge.Vector().Cross(point - edge.Start());
+		Point::Product cross = edge.Vector().Cross(point - edge.Start());
 		winding += (!endsBelow && cross > 0);
 		winding -= (endsBelow && cross <= 0);
 		border += !cross;
@@ -4,8 +4,10 @@ Copyright 2020 Michael Zahniser
 
 #include "Room.h"
 
+#include "Compositor.h"
 #include "Data.h"
 #include "Sprite.h"
+#include "Stats.h"
 
 #include <algorithm>
 #include <fstream>
@@ -14,6 +16,41 @@ using namespace std;
 
 namespace {
 	const Color DEFAULT_BACKGROUND(64, 64, 64);
+	// Size of the cells of the sprite grid. Each cell should be small enough
+	// that most of the cells in a large room are offscreen, but big enough
+	// that most sprites only overlap a few cells.
+	const int GRID_CELL = 256;
+	
+	// Size of the chunks that the ground sprites are cached in.
+	const int GROUND_CHUNK = 512;
+	// Most memory, in bytes, that a room's cached ground chunks may use. This
+	// is more than the chunks that cover a 4K screen, so panning across a
+	// large room only re-renders the chunks that scrolled out of view.
+	const size_t GROUND_CACHE_SIZE = 64 << 20;
+	bool useGroundCache = false;
+	
+	// Free a chunk of the ground cache, and the compositor's views of it.
+	void FreeChunk(SDL_Surface *surface)
+	{
+		Compositor::Forget(surface);
+		SDL_FreeSurface(surface);
+	}
+	
+	// Round down when dividing, even for negative numbers.
+	int Floor(int value, int divisor)
+	{
+		return (value >= 0 ? value / divisor : (value - divisor + 1) / divisor);
+	}
+}
+
+
+
+// Choose whether rooms should cache their static ground sprites. This is
+// off by default, because it is only worthwhile if the rooms do not change
+// often (i.e. in the game rather than the editor).
+void Room::SetGroundCache(bool enabled)
+{
+	useGroundCache = enabled;
 }
 
 
@@ -28,12 +65,12 @@ void Room::Load(Data &data)
 		// Reading an interaction will advance the data "iterator" to the line
 		// after the interaction block. So, we don't want to call Next() after
 		// that; instead, go on to processing other room fields.
-		while(data.Tag() == "interaction")
+		while(data.Key() == Data::INTERACTION)
 			interactions.emplace_back(data);
 		if(!data.Size())
 			break;
 		
-		if(data.Tag() == "background")
+		if(data.Key() == Data::BACKGROUND)
 			background = Color(data[1], data[2], data[3]);
 		else
 			sprites.emplace_back(data);
@@ -46,7 +83,7 @@ void Room::Load(const string &path)
 {
 	Reset();
 	for(Data data(path); data; data.Next())
-		if(data.Tag() == "room")
+		if(data.Key() == Data::ROOM)
 			Load(data);
 	if(name.empty())
 	{
@@ -92,6 +129,11 @@ int Room::Add(int spriteIndex, Point center, const string &name)
 	auto it = upper_bound(sprites.begin(), sprites.end(), entry);
 	int index = it - sprites.begin();
 	sprites.insert(it, entry);
+	gridIsValid = false;
+	// A ground sprite must be added to the cached images. Any other sprite
+	// is drawn after the ground, so it does not affect them.
+	if(static_cast<size_t>(index) <= groundEnd && Sprite::Get(spriteIndex).Layer() < 0)
+		FreeCache();
 	return index;
 }
 
@@ -109,9 +151,12 @@ void Room::Add(const Interaction &interaction)
 // overlaps, this returns -1.
 int Room::Find(Point center)
 {
-	for(const Entry &entry : sprites)
-		if(entry.Bounds().Contains(center))
-			return &entry - &sprites.front();
+	// Only the sprites in the grid cell containing this point can overlap it.
+	vector<int> indices;
+	Visible(Rect(center, center + Point(1, 1)), indices);
+	for(int index : indices)
+		if(sprites[index].Bounds().Contains(center))
+			return index;
 	
 	return -1;
 }
@@ -123,6 +168,9 @@ void Room::Remove(int index)
 {
 	if(static_cast<size_t>(index) < sprites.size())
 		sprites.erase(sprites.begin() + index);
+	gridIsValid = false;
+	if(static_cast<size_t>(index) < groundEnd)
+		FreeCache();
 }
 
 
@@ -142,7 +190,11 @@ void Room::Remove(const string &name)
 	for(vector<Entry>::iterator it = sprites.begin(); it != sprites.end(); )
 	{
 		if(it->Name() == name)
+		{
+			if(static_cast<size_t>(it - sprites.begin()) < groundEnd)
+				FreeCache();
 			sprites.erase(it);
+		}
 		else
 			++it;
 	}
@@ -153,22 +205,69 @@ void Room::Remove(const string &name)
 		else
 			++it;
 	}
+	gridIsValid = false;
 }
 
 
 
-// Draw the entire room, in the given surface, with the given (x, y) offset.
-void Room::Draw(SDL_Surface *screen, Point offset, Point hover, bool hasFocus) const
+// Free the cached images of this room's ground sprites, e.g. because the
+// room is no longer in view.
+void Room::FreeCache()
 {
-	// Fill in the background.
-	SDL_FillRect(screen, nullptr, background(screen));
+	groundIsValid = false;
+	groundEnd = 0;
+	ClearGround();
+}
+
+
+
+// Draw the room in the given surface, with the given (x, y) offset. Only
+// the surface's clipping rectangle is drawn. The given actors (which must
+// be in sorted order) are drawn as if they had been added to the room.
+void Room::Draw(SDL_Surface *screen, Point offset, Point hover, bool hasFocus, const vector<Entry> &actors) const
+{
+	STATS_TIMER(ROOM);
 	
 	// Get the clipping rectangle for the view.
-	Rect bounds = Rect(0, 0, screen->w, screen->h) + offset;
+	const SDL_Rect &clip = screen->clip_rect;
+	Rect bounds = Rect(clip.x, clip.y, clip.w, clip.h) + offset;
+	
+	// The cached ground can only be used if no actor must be drawn under any
+	// part of it.
+	size_t first = 0;
+	if(UpdateGround(screen->format) && (actors.empty() || !(actors.front() < sprites[groundEnd - 1])))
+	{
+		DrawGround(screen, offset, bounds);
+		first = groundEnd;
+	}
+	else
+	{
+		// Fill in the background. This is limited to the clipping rectangle.
+		Compositor::Fill(screen, nullptr, background(screen));
+	}
+	
 	// Draw whatever sprites are within the clipping rectangle.
-	for(const Entry &entry : sprites)
+	auto draw = [&](const Entry &entry)
+	{
 		if(entry.Bounds().Overlaps(bounds))
 			Sprite::Get(entry.Index()).Draw(screen, entry.Center() - offset);
+	};
+	vector<int> indices;
+	Visible(bounds, indices);
+	indices.erase(indices.begin(), lower_bound(indices.begin(), indices.end(), static_cast<int>(first)));
+	// Merge the actors into the draw order. Add() puts a sprite after any
+	// that sort equal to it, so an actor is drawn before a sprite only if it
+	// sorts strictly before it.
+	vector<Entry>::const_iterator actor = actors.begin();
+	for(int index : indices)
+	{
+		const Entry &entry = sprites[index];
+		for( ; actor != actors.end() && *actor < entry; ++actor)
+			draw(*actor);
+		draw(entry);
+	}
+	for( ; actor != actors.end(); ++actor)
+		draw(*actor);
 	
 	// Draw interaction icons.
 	for(const Interaction &it : interactions)
@@ -190,6 +289,57 @@ void Room::Draw(SDL_Surface *screen, Point offset, Point hover, bool hasFocus) c
 
 
 
+// Add to the given list the screen rectangles that may change from one
+// frame to the next even if nothing moves: animated sprites within the
+// given view, and interaction icons (including their hover states).
+void Room::Damage(Point offset, Point size, vector<Rect> &rects) const
+{
+	Rect bounds = Rect(offset, offset + size);
+	vector<int> indices;
+	Visible(bounds, indices);
+	for(int index : indices)
+	{
+		const Entry &entry = sprites[index];
+		if(Sprite::Get(entry.Index()).IsAnimated() && entry.Bounds().Overlaps(bounds))
+			rects.push_back(entry.Bounds() - offset);
+	}
+	
+	for(const Interaction &it : interactions)
+	{
+		if(!it.Icon())
+			continue;
+		
+		Point center = it.Position() + it.Offset() - offset;
+		rects.push_back(Sprite::Get(it.Icon()).Bounds() + center);
+		rects.push_back(Sprite::Get(it.HoverIcon()).Bounds() + center);
+	}
+}
+
+
+
+// Check if anything within the given view may change from one frame to the
+// next even if nothing moves.
+bool Room::IsAnimated(Point offset, Point size) const
+{
+	Rect bounds = Rect(offset, offset + size);
+	vector<int> indices;
+	Visible(bounds, indices);
+	for(int index : indices)
+	{
+		const Entry &entry = sprites[index];
+		if(Sprite::Get(entry.Index()).IsAnimated() && entry.Bounds().Overlaps(bounds))
+			return true;
+	}
+	
+	for(const Interaction &it : interactions)
+		if(it.Icon() && (Sprite::Get(it.Icon()).IsAnimated() || Sprite::Get(it.HoverIcon()).IsAnimated()))
+			return true;
+	
+	return false;
+}
+
+
+
 // Access the raw list of sprites.
 const vector<Room::Entry> &Room::Sprites() const
 {
@@ -296,4 +446,211 @@ void Room::Reset()
 	background = DEFAULT_BACKGROUND;
 	sprites.clear();
 	interactions.clear();
+	gridIsValid = false;
+	FreeCache();
+}
+
+
+
+// Get the indices of all sprites that may overlap the given rectangle,
+// in draw order. This uses the grid, rebuilding it first if necessary.
+void Room::Visible(const Rect &bounds, vector<int> &indices) const
+{
+	indices.clear();
+	if(sprites.empty())
+		return;
+	
+	if(!gridIsValid)
+	{
+		// Find the area that the sprites cover, in grid cells.
+		Rect extent = sprites.front().Bounds();
+		for(const Entry &entry : sprites)
+		{
+			Rect bounds = entry.Bounds();
+			SDL_UnionRect(&extent, &bounds, &extent);
+		}
+		gridOrigin = Point(Floor(extent.x, GRID_CELL), Floor(extent.y, GRID_CELL)) * GRID_CELL;
+		gridColumns = Floor(extent.x + extent.w - gridOrigin.X() - 1, GRID_CELL) + 1;
+		gridRows = Floor(extent.y + extent.h - gridOrigin.Y() - 1, GRID_CELL) + 1;
+		
+		// Add each sprite to every cell it overlaps. Because the sprites are
+		// added in order, each cell's list is sorted.
+		grid.assign(gridColumns * gridRows, vector<int>());
+		for(size_t i = 0; i < sprites.size(); ++i)
+		{
+			Rect cells = Cells(sprites[i].Bounds());
+			for(int y = cells.y; y < cells.y + cells.h; ++y)
+				for(int x = cells.x; x < cells.x + cells.w; ++x)
+					grid[x + y * gridColumns].push_back(i);
+		}
+		gridIsValid = true;
+	}
+	
+	// Gather the sprites from each cell that is in view. A sprite that spans
+	// several cells will be listed more than once.
+	Rect cells = Cells(bounds);
+	for(int y = cells.y; y < cells.y + cells.h; ++y)
+		for(int x = cells.x; x < cells.x + cells.w; ++x)
+		{
+			const vector<int> &cell = grid[x + y * gridColumns];
+			indices.insert(indices.end(), cell.begin(), cell.end());
+		}
+	// Restore the draw order, and remove any duplicates.
+	sort(indices.begin(), indices.end());
+	indices.erase(unique(indices.begin(), indices.end()), indices.end());
+}
+
+
+
+// Find the ground sprites, if necessary, and return true if there are
+// any. The cache is cleared if it does not match the given format.
+bool Room::UpdateGround(const SDL_PixelFormat *format) const
+{
+	if(!useGroundCache)
+		return false;
+	if(groundFormat != format->format)
+	{
+		ClearGround();
+		groundFormat = format->format;
+	}
+	if(!groundIsValid)
+	{
+		ClearGround();
+		groundEnd = 0;
+		while(groundEnd < sprites.size())
+		{
+			const Sprite &sprite = Sprite::Get(sprites[groundEnd].Index());
+			if(sprite.Layer() >= 0 || sprite.IsAnimated())
+				break;
+			
+			Rect bounds = sprites[groundEnd].Bounds();
+			if(groundEnd)
+				SDL_UnionRect(&groundBounds, &bounds, &groundBounds);
+			else
+				groundBounds = bounds;
+			++groundEnd;
+		}
+		groundIsValid = true;
+	}
+	return groundEnd;
+}
+
+
+
+// Draw the cached ground sprites in the given view.
+void Room::DrawGround(SDL_Surface *screen, Point offset, const Rect &bounds) const
+{
+	// Only the parts of the view outside the cached chunks need to be filled.
+	Point first(Floor(groundBounds.x, GROUND_CHUNK), Floor(groundBounds.y, GROUND_CHUNK));
+	Point last(
+		Floor(groundBounds.x + groundBounds.w - 1, GROUND_CHUNK),
+		Floor(groundBounds.y + groundBounds.h - 1, GROUND_CHUNK));
+	Rect cached(first * GROUND_CHUNK, (last + Point(1, 1)) * GROUND_CHUNK);
+	if(!(bounds.x >= cached.x && bounds.y >= cached.y
+			&& bounds.x + bounds.w <= cached.x + cached.w && bounds.y + bounds.h <= cached.y + cached.h))
+		Compositor::Fill(screen, nullptr, background(screen));
+	
+	// Draw each chunk that is in view, rendering it first if necessary.
+	++groundDraws;
+	int left = max(first.X(), Floor(bounds.x, GROUND_CHUNK));
+	int top = max(first.Y(), Floor(bounds.y, GROUND_CHUNK));
+	int right = min(last.X(), Floor(bounds.x + bounds.w - 1, GROUND_CHUNK));
+	int bottom = min(last.Y(), Floor(bounds.y + bounds.h - 1, GROUND_CHUNK));
+	for(int y = top; y <= bottom; ++y)
+		for(int x = left; x <= right; ++x)
+		{
+			Point corner = Point(x, y) * GROUND_CHUNK;
+			Chunk &chunk = groundChunks[make_pair(x, y)];
+			if(!chunk.surface)
+			{
+				chunk.surface = RenderChunk(corner, screen->format);
+				if(chunk.surface)
+					groundMemory += chunk.surface->pitch * chunk.surface->h;
+			}
+			if(!chunk.surface)
+				continue;
+			
+			chunk.used = groundDraws;
+			chunk.frame = Compositor::Frames();
+			Rect rect = Rect(corner - offset, corner - offset + Point(GROUND_CHUNK, GROUND_CHUNK));
+			Compositor::Blit(chunk.surface.get(), nullptr, screen, &rect);
+		}
+	TrimGround();
+}
+
+
+
+// Draw the ground sprites into a new chunk of the cache.
+shared_ptr<SDL_Surface> Room::RenderChunk(Point corner, const SDL_PixelFormat *format) const
+{
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(
+		0, GROUND_CHUNK, GROUND_CHUNK, format->BitsPerPixel, format->format);
+	if(!surface)
+		return nullptr;
+	
+	// The chunk is opaque, so it can be drawn without blending.
+	SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+	SDL_FillRect(surface, nullptr, background(surface));
+	vector<int> indices;
+	Visible(Rect(corner, corner + Point(GROUND_CHUNK, GROUND_CHUNK)), indices);
+	for(int index : indices)
+	{
+		if(static_cast<size_t>(index) >= groundEnd)
+			break;
+		
+		const Entry &entry = sprites[index];
+		Sprite::Get(entry.Index()).Draw(surface, entry.Center() - corner);
+	}
+	return shared_ptr<SDL_Surface>(surface, FreeChunk);
+}
+
+
+
+// Free the least recently drawn chunks of the cached ground until it fits in
+// its memory budget.
+void Room::TrimGround() const
+{
+	while(groundMemory > GROUND_CACHE_SIZE)
+	{
+		// Chunks that were just drawn are still needed. If the compositor is
+		// enabled, any chunk drawn in this frame may still be in its queue.
+		auto oldest = groundChunks.end();
+		for(auto it = groundChunks.begin(); it != groundChunks.end(); ++it)
+			if(it->second.surface && it->second.used != groundDraws
+					&& (!Compositor::IsEnabled() || it->second.frame != Compositor::Frames())
+					&& (oldest == groundChunks.end() || it->second.used < oldest->second.used))
+				oldest = it;
+		if(oldest == groundChunks.end())
+			break;
+		
+		groundMemory -= oldest->second.surface->pitch * oldest->second.surface->h;
+		groundChunks.erase(oldest);
+	}
+}
+
+
+
+// Free all the cached ground chunks.
+void Room::ClearGround() const
+{
+	groundChunks.clear();
+	groundMemory = 0;
+}
+
+
+
+// Get the range of grid cells that the given rectangle overlaps.
+Rect Room::Cells(const Rect &bounds) const
+{
+	// Clamp the range to the grid. If the rectangle is outside the grid, or
+	// is empty, this returns an empty range.
+	Point start = bounds.TopLeft() - gridOrigin;
+	Point end = start + bounds.Size();
+	int left = max(0, Floor(start.X(), GRID_CELL));
+	int top = max(0, Floor(start.Y(), GRID_CELL));
+	int right = min(gridColumns, Floor(end.X() - 1, GRID_CELL) + 1);
+	int bottom = min(gridRows, Floor(end.Y() - 1, GRID_CELL) + 1);
+	if(bounds.w <= 0 || bounds.h <= 0)
+		right = left;
+	return Rect(left, top, max(0, right - left), max(0, bottom - top));
 }
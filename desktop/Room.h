@@ -14,7 +14,11 @@ Copyright 2020 Michael Zahniser
 
 #include <SDL2/SDL.h>
 
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -22,6 +26,13 @@ using namespace std;
 
 
 class Room {
+public:
+	// Choose whether rooms should cache their static ground sprites. This is
+	// off by default, because it is only worthwhile if the rooms do not change
+	// often (i.e. in the game rather than the editor).
+	static void SetGroundCache(bool enabled);
+	
+	
 public:
 	// Read or write a room to a data file.
 	void Load(Data &data);
@@ -45,12 +56,25 @@ public:
 	void Remove(const Interaction *interaction);
 	// Remove all sprites and interactions with the give name.
 	void Remove(const string &name);
+	// Free the cached images of this room's ground sprites, e.g. because the
+	// room is no longer in view.
+	void FreeCache();
 	
-	// Draw the entire room, in the given surface, with the given (x, y) offset.
-	void Draw(SDL_Surface *screen, Point offset, Point hover, bool hasFocus) const;
+	// Draw the room in the given surface, with the given (x, y) offset. Only
+	// the surface's clipping rectangle is drawn. The given actors (which must
+	// be in sorted order) are drawn as if they had been added to the room.
+	class Entry;
+	void Draw(SDL_Surface *screen, Point offset, Point hover, bool hasFocus, const vector<Entry> &actors = {}) const;
+	// Add to the given list the screen rectangles that may change from one
+	// frame to the next even if nothing moves: animated sprites within the
+	// given view, and interaction icons (including their hover states).
+	void Damage(Point offset, Point size, vector<Rect> &rects) const;
+	// Check if anything within the given view may change from one frame to the
+	// next even if nothing moves, i.e. if any animated sprites or interaction
+	// icons are visible.
+	bool IsAnimated(Point offset, Point size) const;
 	
 	// Access the raw list of sprites.
-	class Entry;
 	const vector<Entry> &Sprites() const;
 	
 	// Access the list of interactions.
@@ -93,6 +117,35 @@ public:
 private:
 	// Reset to an "empty" state.
 	void Reset();
+	// Get the indices of all sprites that may overlap the given rectangle,
+	// in draw order. This uses the grid, rebuilding it first if necessary.
+	void Visible(const Rect &bounds, vector<int> &indices) const;
+	// Get the range of grid cells that the given rectangle overlaps.
+	Rect Cells(const Rect &bounds) const;
+	// Find the ground sprites, if necessary, and return true if there are
+	// any. The cache is cleared if it does not match the given format.
+	bool UpdateGround(const SDL_PixelFormat *format) const;
+	// Draw the cached ground sprites in the given view.
+	void DrawGround(SDL_Surface *screen, Point offset, const Rect &bounds) const;
+	// Draw the ground sprites into a new chunk of the cache.
+	shared_ptr<SDL_Surface> RenderChunk(Point corner, const SDL_PixelFormat *format) const;
+	// Free the least recently drawn chunks of the cached ground until it fits
+	// in its memory budget.
+	void TrimGround() const;
+	// Free all the cached ground chunks.
+	void ClearGround() const;
+	
+	
+private:
+	// A chunk of the cached ground, and when it was last drawn.
+	class Chunk {
+	public:
+		shared_ptr<SDL_Surface> surface;
+		// Which call to DrawGround() this was last drawn in, to find the least
+		// recently used chunks, and which compositor frame that was in.
+		uint64_t used = 0;
+		uint64_t frame = 0;
+	};
 	
 	
 private:
@@ -100,6 +153,27 @@ private:
 	Color background;
 	vector<Entry> sprites;
 	vector<Interaction> interactions;
+	
+	// To avoid checking every sprite when drawing, the room is divided into a
+	// grid of square cells, each with a list of the sprites that overlap it
+	// (in draw order). This is rebuilt whenever the list of sprites changes.
+	mutable bool gridIsValid = false;
+	mutable Point gridOrigin;
+	mutable int gridColumns = 0;
+	mutable int gridRows = 0;
+	mutable vector<vector<int>> grid;
+	
+	// The "ground" is the run of non-animated sprites in negative layers at
+	// the start of the draw order. If the ground cache is enabled, it is drawn
+	// in square chunks that are rendered the first time they come into view,
+	// and freed when they have not been drawn for a while.
+	mutable bool groundIsValid = false;
+	mutable size_t groundEnd = 0;
+	mutable Rect groundBounds;
+	mutable uint32_t groundFormat = 0;
+	mutable map<pair<int, int>, Chunk> groundChunks;
+	mutable size_t groundMemory = 0;
+	mutable uint64_t groundDraws = 0;
 };
 
 
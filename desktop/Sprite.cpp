@@ -4,12 +4,18 @@ Copyright 2020 Michae Zahniser
 
 #include "Sprite.h"
 
+#include "Bundle.h"
+#include "Compositor.h"
+#include "Trace.h"
+
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
-#include <SDL2/SDL_image.h>
-
 using namespace std;
 
 namespace {
@@ -18,8 +24,124 @@ namespace {
 	
 	size_t nextIndex = 1;
 	vector<SDL_Surface *> sheets;
+	// Sheets by path, so that sprite files that share one sheet (such as an
+	// atlas) only load it once.
+	map<string, SDL_Surface *> loaded;
+	// The sheet that new sprites are added from.
+	SDL_Surface *current = nullptr;
+	// Copies of the sheets, converted to the display format by Prepare().
+	vector<SDL_Surface *> prepared;
 	
 	size_t step = 0;
+	
+	// Ways that a sprite frame can be drawn, from fastest to slowest.
+	enum Transparency {OPAQUE, KEYED, BLENDED};
+	
+	// Check what kind of transparency the given part of an ARGB8888 surface
+	// needs in order to be drawn correctly.
+	Transparency Classify(const SDL_Surface *surface, Rect rect)
+	{
+		Transparency result = OPAQUE;
+		if(!SDL_IntersectRect(&rect, &surface->clip_rect, &rect))
+			return result;
+		
+		for(int y = rect.y; y < rect.y + rect.h; ++y)
+		{
+			const uint8_t *bytes = reinterpret_cast<const uint8_t *>(surface->pixels) + y * surface->pitch;
+			const uint32_t *row = reinterpret_cast<const uint32_t *>(bytes);
+			for(int x = rect.x; x < rect.x + rect.w; ++x)
+			{
+				uint32_t alpha = row[x] >> 24;
+				if(alpha && alpha != 255)
+					return BLENDED;
+				if(!alpha)
+					result = KEYED;
+			}
+		}
+		return result;
+	}
+	
+	// Find an RGB color that none of the opaque pixels in the given ARGB8888
+	// surface use, so it can be used as a color key.
+	uint32_t FindKey(const SDL_Surface *surface)
+	{
+		// Start with magenta, which is unlikely to be used in any artwork.
+		for(uint32_t key = 0xFF00FF; ; key = (key + 0x010203) & 0xFFFFFF)
+		{
+			bool isUsed = false;
+			for(int y = 0; y < surface->h && !isUsed; ++y)
+			{
+				const uint8_t *bytes = reinterpret_cast<const uint8_t *>(surface->pixels) + y * surface->pitch;
+				const uint32_t *row = reinterpret_cast<const uint32_t *>(bytes);
+				for(int x = 0; x < surface->w && !isUsed; ++x)
+					isUsed = (row[x] == (key | 0xFF000000));
+			}
+			if(!isUsed)
+				return key;
+		}
+	}
+	
+	// Get a format with an alpha channel that otherwise matches the given
+	// format, so that blending does not need to shuffle the color channels.
+	uint32_t AlphaFormat(const SDL_PixelFormat *format)
+	{
+		uint32_t rgb = format->Rmask | format->Gmask | format->Bmask;
+		uint32_t result = SDL_PIXELFORMAT_UNKNOWN;
+		if(format->BytesPerPixel == 4)
+			result = SDL_MasksToPixelFormatEnum(32, format->Rmask, format->Gmask, format->Bmask, ~rgb);
+		return (result == SDL_PIXELFORMAT_UNKNOWN ? SDL_PIXELFORMAT_ARGB8888 : result);
+	}
+	
+	// Make a copy of the given ARGB8888 sheet for drawing frames with the
+	// given type of transparency onto surfaces with the given format.
+	SDL_Surface *Convert(SDL_Surface *sheet, Transparency type, const SDL_PixelFormat *format)
+	{
+		SDL_Surface *copy = nullptr;
+		if(type == OPAQUE)
+		{
+			copy = SDL_ConvertSurface(sheet, format, 0);
+			if(copy)
+				SDL_SetSurfaceBlendMode(copy, SDL_BLENDMODE_NONE);
+		}
+		else if(type == KEYED)
+		{
+			// Replace the transparent pixels with the key color, then convert
+			// the result to the display format.
+			uint32_t key = FindKey(sheet);
+			SDL_Surface *keyed = SDL_ConvertSurface(sheet, sheet->format, 0);
+			if(!keyed)
+				return nullptr;
+			for(int y = 0; y < keyed->h; ++y)
+			{
+				uint8_t *bytes = reinterpret_cast<uint8_t *>(keyed->pixels) + y * keyed->pitch;
+				uint32_t *row = reinterpret_cast<uint32_t *>(bytes);
+				for(int x = 0; x < keyed->w; ++x)
+					if(!(row[x] >> 24))
+						row[x] = key | 0xFF000000;
+			}
+			copy = SDL_ConvertSurface(keyed, format, 0);
+			SDL_FreeSurface(keyed);
+			if(copy)
+			{
+				SDL_SetSurfaceBlendMode(copy, SDL_BLENDMODE_NONE);
+				SDL_SetColorKey(copy, SDL_TRUE, SDL_MapRGB(copy->format, key >> 16, key >> 8, key));
+				SDL_SetSurfaceRLE(copy, !Compositor::IsEnabled());
+			}
+		}
+		else
+		{
+			// Frames that can be drawn with a span mask need the original
+			// pixels, so they can't use RLE.
+			copy = SDL_ConvertSurfaceFormat(sheet, AlphaFormat(format), 0);
+			if(copy)
+			{
+				SDL_SetSurfaceBlendMode(copy, SDL_BLENDMODE_BLEND);
+				bool hasMask = Blitter::IsSupported(copy->format, format);
+				SDL_SetSurfaceRLE(copy, !Compositor::IsEnabled() && !hasMask);
+			}
+		}
+		return copy;
+	}
 }
 
 
@@ -34,11 +156,19 @@ void Sprite::SetIndex(Data &data)
 
 
 // The given data object is currently at a "sheet" command. Load the sprite
-// sheet image file that it specifies.
+// sheet image file that it specifies, unless it has already been loaded.
 void Sprite::LoadSheet(Data &data)
 {
 	string path = data.Directory() + data.Value();
-	sheets.emplace_back(IMG_Load(path.c_str()));
+	Trace::Span span("Sprite::LoadSheet", path);
+	SDL_Surface *&sheet = loaded[path];
+	if(!sheet)
+	{
+		sheet = Bundle::LoadImage(path);
+		if(sheet)
+			sheets.push_back(sheet);
+	}
+	current = sheet;
 }
 
 
@@ -48,43 +178,54 @@ void Sprite::LoadSheet(Data &data)
 int Sprite::Add(Data &data)
 {
 	// Bail out if no sprite sheet has been loaded.
-	if(sheets.empty() || !sheets.back())
+	if(!current)
 		return 0;
 	// Resize the sprite array if necessary to include this index.
 	if(nextIndex >= sprites.size())
 		sprites.resize(nextIndex + 1);
 	
 	Sprite &sprite = sprites[nextIndex];
-	sprite.sheet = sheets.back();
+	sprite.sheet = current;
 	// Loop until we find an empty line, interpreting every line until than as
 	// a part of the data for this sprite.
 	bool hasBaseline = false;
 	while(data.Next() && data.Size())
 	{
-		if(data.Tag() == "bounds")
-		{
-			Point a = data[1];
-			Point b = data[2];
-			if(!sprite.source.empty())
-				b = a + Point(sprite.source.front().w, sprite.source.front().h);
-			sprite.source.emplace_back(a, b);
-		}
-		else if(data.Tag() == "baseline" && data.Size() == 2)
+		// The baseline and layer must have exactly one value.
+		Data::Keyword key = data.Key();
+		if((key == Data::BASELINE || key == Data::LAYER) && data.Size() != 2)
+			key = Data::OTHER;
+		
+		switch(key)
 		{
-			sprite.bounds.y = data[1];
-			hasBaseline = true;
+			case Data::BOUNDS:
+			{
+				Point a = data[1];
+				Point b = data[2];
+				if(!sprite.source.empty())
+					b = a + Point(sprite.source.front().w, sprite.source.front().h);
+				sprite.source.emplace_back(a, b);
+				break;
+			}
+			case Data::BASELINE:
+				sprite.bounds.y = data[1];
+				hasBaseline = true;
+				break;
+			case Data::LAYER:
+				sprite.layer = data[1];
+				break;
+			case Data::MASK:
+			{
+				sprite.mask.emplace_back();
+				vector<Point> &part = sprite.mask.back();
+				for(size_t i = 1; i < data.Size(); ++i)
+					part.push_back(data[i]);
+				break;
+			}
+			default:
+				cerr << "Sprite: error:" << data.Line() << endl;
+				break;
 		}
-		else if(data.Tag() == "layer" && data.Size() == 2)
-			sprite.layer = data[1];
-		else if(data.Tag() == "mask")
-		{
-			sprite.mask.emplace_back();
-			vector<Point> &part = sprite.mask.back();
-			for(size_t i = 1; i < data.Size(); ++i)
-				part.push_back(data[i]);
-		}
-		else
-			cerr << "Sprite: error:" << data.Line() << endl;
 	}
 	// Coordinates for the sprite mask, etc.  should be relative to this point.
 	// If no baseline was given, use the middle of the sprite. Otherwise,
@@ -115,18 +256,77 @@ const Sprite &Sprite::Get(int index)
 
 
 
+// Convert the sprite sheets to the given pixel format (normally that of
+// the window surface) so that drawing does not need to convert pixels.
+// Each frame is drawn from a copy of its sheet suited to its transparency.
+void Sprite::Prepare(const SDL_PixelFormat *format)
+{
+	for(SDL_Surface *surface : prepared)
+		SDL_FreeSurface(surface);
+	prepared.clear();
+	
+	// Each sheet is converted to ARGB8888 so its pixels can be examined, and
+	// then copied once for each type of transparency that its frames need.
+	map<SDL_Surface *, SDL_Surface *> argb;
+	map<pair<SDL_Surface *, Transparency>, SDL_Surface *> copies;
+	for(Sprite &sprite : sprites)
+	{
+		sprite.frames.clear();
+		sprite.masks.clear();
+		if(!sprite.sheet)
+			continue;
+		
+		SDL_Surface *&source = argb[sprite.sheet];
+		if(!source)
+			source = SDL_ConvertSurfaceFormat(sprite.sheet, SDL_PIXELFORMAT_ARGB8888, 0);
+		if(!source)
+			continue;
+		
+		for(const Rect &rect : sprite.source)
+		{
+			Transparency type = Classify(source, rect);
+			SDL_Surface *&copy = copies[make_pair(sprite.sheet, type)];
+			if(!copy)
+			{
+				copy = Convert(source, type, format);
+				if(copy)
+					prepared.push_back(copy);
+			}
+			// If the conversion failed, fall back to the original sheet.
+			sprite.frames.push_back(copy ? copy : sprite.sheet);
+			sprite.masks.emplace_back();
+			if(copy && type == BLENDED && Blitter::IsSupported(copy->format, format))
+				sprite.masks.back() = Blitter(copy, rect);
+		}
+	}
+	for(const auto &it : argb)
+		if(it.second)
+			SDL_FreeSurface(it.second);
+}
+
+
+
 // Free all the sprite sheets.
 void Sprite::FreeAll()
 {
+	for(Sprite &sprite : sprites)
+	{
+		sprite.frames.clear();
+		sprite.masks.clear();
+	}
+	for(SDL_Surface *surface : prepared)
+		SDL_FreeSurface(surface);
+	prepared.clear();
 	for(SDL_Surface *surface : sheets)
-		if(surface)
-			SDL_FreeSurface(surface);
+		SDL_FreeSurface(surface);
 	sheets.clear();
+	loaded.clear();
+	current = nullptr;
 }
 
 
 
-	
+
 // Step the animation forward.
 void Sprite::Step()
 {
@@ -177,6 +377,15 @@ int Sprite::Height() const
 
 
 
+// Check if this sprite has more than one animation frame, i.e. whether it
+// may look different after each Step().
+bool Sprite::IsAnimated() const
+{
+	return (source.size() > 1);
+}
+
+
+
 // Draw this sprite with its center baseline at the given position.
 void Sprite::Draw(SDL_Surface *surface, Point center) const
 {
@@ -184,8 +393,12 @@ void Sprite::Draw(SDL_Surface *surface, Point center) const
 	if(source.empty())
 		return;
 	
+	size_t frame = step % source.size();
 	Rect rect = bounds + center;
-	SDL_BlitSurface(sheet, &source[step % source.size()], surface, &rect);
+	if(frames.empty())
+		Compositor::Blit(sheet, &source[frame], surface, &rect);
+	else
+		Compositor::Blit(masks[frame], frames[frame], &source[frame], surface, &rect);
 }
 
 
@@ -5,6 +5,7 @@ Copyright 2020 Michael Zahniser
 #ifndef SPRITE_H_
 #define SPRITE_H_
 
+#include "Blitter.h"
 #include "Data.h"
 #include "Point.h"
 #include "Polygon.h"
@@ -24,7 +25,7 @@ public:
 	// to be used for the next sprite, based on it.
 	static void SetIndex(Data &data);
 	// The given data object is currently at a "sheet" command. Load the sprite
-	// sheet image file that it specifies.
+	// sheet image file that it specifies, unless it has already been loaded.
 	static void LoadSheet(Data &data);
 	// The given data object is currently at the start of a "sprite" object.
 	// Read the sprite information and advance to the end of that data block.
@@ -33,6 +34,14 @@ public:
 	// Get the sprite with the given index. If no sprite with that index exists,
 	// this will return an "empty" sprite.
 	static const Sprite &Get(int index);
+	// Convert the sprite sheets to the given pixel format (normally that of
+	// the window surface) so that drawing does not need to convert pixels.
+	// Each frame is drawn from a copy of its sheet suited to its transparency:
+	// opaque frames are copied directly, frames whose pixels are all either
+	// opaque or fully transparent use a color key, and any others use alpha
+	// blending with a precomputed span mask. If the compositor is disabled,
+	// keyed frames use RLE, and so do blended ones if the mask can't be used.
+	static void Prepare(const SDL_PixelFormat *format);
 	// Free all the sprite sheets.
 	static void FreeAll();
 	
@@ -53,6 +62,9 @@ public:
 	// Convenience functions to get the sprite dimensions.
 	int Width() const;
 	int Height() const;
+	// Check if this sprite has more than one animation frame, i.e. whether it
+	// may look different after each Step().
+	bool IsAnimated() const;
 	
 	// Draw this sprite with its center baseline at the given position.
 	void Draw(SDL_Surface *surface, Point center) const;
@@ -65,6 +77,11 @@ private:
 	SDL_Surface *sheet = nullptr;
 	// Bounding box of the sprite within the spritesheet.
 	vector<Rect> source;
+	// Once the sheets have been prepared, this is the copy of the sheet to use
+	// for drawing each frame.
+	vector<SDL_Surface *> frames;
+	// Span masks for drawing any frames that need alpha blending.
+	vector<Blitter> masks;
 	// Bounding box to use when drawing the sprite.
 	Rect bounds;
 	// Collision mask.
@@ -0,0 +1,247 @@
+/* Stats.cpp
+Copyright 2020 Michael Zahniser
+*/
+
+#include "Stats.h"
+
+#include "Color.h"
+#include "Compositor.h"
+#include "Font.h"
+#include "Point.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Number of recent frames that the percentiles are calculated from.
+	const size_t HISTORY = 240;
+	// Percentiles to show in the overlay.
+	const int PERCENTILES[] = {50, 90, 99, 100};
+	// Layout of the overlay.
+	const int PAD = 6;
+	const int COLUMN = 70;
+	const Color BACKGROUND(0);
+	
+	const char *PHASE_NAMES[Stats::PHASES] = {
+		"events", "step", "draw", "room", "dialog", "wrap", "paths"};
+	const char *COUNTER_NAMES[Stats::COUNTERS] = {
+		"steps", "rects", "pixels", "wraps", "hits", "misses", "cache kB"};
+	
+	// Totals for the current frame, in milliseconds.
+	double phases[Stats::PHASES];
+	int counters[Stats::COUNTERS];
+	// Totals for recent frames. Each is a ring buffer, with the oldest frame
+	// at the position given by "frame" once it has wrapped around.
+	vector<double> phaseHistory[Stats::PHASES];
+	vector<int> counterHistory[Stats::COUNTERS];
+	size_t frame = 0;
+	
+	bool isVisible = false;
+	ofstream logFile;
+	bool isJson = false;
+	
+	// Get the given percentile of the given values.
+	template <class Type>
+	Type Percentile(vector<Type> values, int percentile)
+	{
+		if(values.empty())
+			return Type();
+		
+		size_t index = min(values.size() - 1, percentile * values.size() / 100);
+		nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+	
+	// Format a time or a count for the overlay.
+	string Format(double milliseconds)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.2f", milliseconds);
+		return buffer;
+	}
+	
+	string Format(int count)
+	{
+		return to_string(count);
+	}
+	
+	// Draw one row of the overlay: a name, then the given percentiles.
+	template <class Type>
+	void DrawRow(SDL_Surface *surface, Point corner, const char *name, const vector<Type> &values)
+	{
+		const Font &font = Font::Get();
+		font.Draw(name, corner, surface);
+		for(int percentile : PERCENTILES)
+		{
+			corner += Point(COLUMN, 0);
+			font.Draw(Format(Percentile(values, percentile)), corner, surface);
+		}
+	}
+}
+
+
+
+// Add the time from this object's construction to its destruction to the
+// total for the given phase in the current frame.
+Stats::Timer::Timer(Phase phase)
+	: phase(phase), start(chrono::steady_clock::now())
+{
+}
+
+
+
+Stats::Timer::~Timer()
+{
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	phases[phase] += elapsed.count();
+}
+
+
+
+// Add to one of the counters for the current frame.
+void Stats::Count(Counter counter, int amount)
+{
+	counters[counter] += amount;
+}
+
+
+
+// Finish the current frame: save its totals and log them, then reset them.
+void Stats::EndFrame()
+{
+	counters[TEXT_KB] = Font::CacheMemory() / 1024;
+	
+	size_t index = frame++ % HISTORY;
+	for(int i = 0; i < PHASES; ++i)
+	{
+		if(phaseHistory[i].size() < HISTORY)
+			phaseHistory[i].push_back(phases[i]);
+		else
+			phaseHistory[i][index] = phases[i];
+	}
+	for(int i = 0; i < COUNTERS; ++i)
+	{
+		if(counterHistory[i].size() < HISTORY)
+			counterHistory[i].push_back(counters[i]);
+		else
+			counterHistory[i][index] = counters[i];
+	}
+	
+	if(logFile.is_open())
+	{
+		if(isJson)
+		{
+			logFile << (frame > 1 ? ",\n" : "") << "{\"frame\": " << frame;
+			for(int i = 0; i < PHASES; ++i)
+				logFile << ", \"" << PHASE_NAMES[i] << "\": " << phases[i];
+			for(int i = 0; i < COUNTERS; ++i)
+				logFile << ", \"" << COUNTER_NAMES[i] << "\": " << counters[i];
+			logFile << '}';
+		}
+		else
+		{
+			logFile << frame;
+			for(int i = 0; i < PHASES; ++i)
+				logFile << ',' << phases[i];
+			for(int i = 0; i < COUNTERS; ++i)
+				logFile << ',' << counters[i];
+			logFile << '\n';
+		}
+	}
+	
+	fill(phases, phases + PHASES, 0.);
+	fill(counters, counters + COUNTERS, 0);
+}
+
+
+
+// Show or hide the overlay.
+void Stats::Toggle()
+{
+	isVisible = !isVisible;
+}
+
+
+
+bool Stats::IsVisible()
+{
+	return isVisible;
+}
+
+
+
+// Draw the overlay in the top left corner of the given surface, and return
+// the rectangle that it covers.
+Rect Stats::Draw(SDL_Surface *surface)
+{
+	const int lineHeight = Font::Get().Height() + 2;
+	const int columns = sizeof(PERCENTILES) / sizeof(PERCENTILES[0]);
+	Rect rect(0, 0, 2 * PAD + COLUMN * (columns + 1), 2 * PAD + lineHeight * (1 + PHASES + COUNTERS));
+	Compositor::Fill(surface, &rect, BACKGROUND(surface));
+	
+	const Font &font = Font::Get();
+	Point corner(PAD, PAD);
+	font.Draw("ms", corner, surface);
+	for(int percentile : PERCENTILES)
+	{
+		corner += Point(COLUMN, 0);
+		font.Draw(percentile == 100 ? "max" : "p" + to_string(percentile), corner, surface);
+	}
+	
+	corner = Point(PAD, PAD);
+	for(int i = 0; i < PHASES; ++i)
+	{
+		corner += Point(0, lineHeight);
+		DrawRow(surface, corner, PHASE_NAMES[i], phaseHistory[i]);
+	}
+	for(int i = 0; i < COUNTERS; ++i)
+	{
+		corner += Point(0, lineHeight);
+		DrawRow(surface, corner, COUNTER_NAMES[i], counterHistory[i]);
+	}
+	return rect;
+}
+
+
+
+// Log the totals for every frame to the given file. If its extension is
+// ".json" it is written as a JSON array; otherwise, it is a CSV file.
+bool Stats::OpenLog(const string &path)
+{
+	CloseLog();
+	logFile.open(path);
+	if(!logFile)
+		return false;
+	
+	isJson = (path.size() >= 5 && !path.compare(path.size() - 5, 5, ".json"));
+	if(isJson)
+		logFile << "[\n";
+	else
+	{
+		logFile << "frame";
+		for(const char *name : PHASE_NAMES)
+			logFile << ',' << name;
+		for(const char *name : COUNTER_NAMES)
+			logFile << ',' << name;
+		logFile << '\n';
+	}
+	// Only number the frames from when the log was opened.
+	frame = 0;
+	return true;
+}
+
+
+
+void Stats::CloseLog()
+{
+	if(!logFile.is_open())
+		return;
+	
+	if(isJson)
+		logFile << "\n]\n";
+	logFile.close();
+}
@@ -0,0 +1,79 @@
+/* Stats.h
+Copyright 2020 Michael Zahniser
+*/
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "Rect.h"
+
+#include <SDL2/SDL.h>
+
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+
+
+// Instrumentation for finding out where the time in each frame goes. Scoped
+// timers add up how long each phase of the frame takes, and counters record
+// how much work it did. The totals for recent frames can be shown as an
+// overlay with their percentiles, and every frame can be logged to a file.
+// The timers and counters are only compiled in if WHIMSY_STATS is defined;
+// otherwise the STATS_TIMER() and STATS_COUNT() macros expand to nothing.
+class Stats {
+public:
+	// Parts of a frame that are timed. They may be nested, e.g. ROOM and
+	// DIALOG are part of DRAW, so each one is the total time inside it.
+	enum Phase {EVENTS, STEP, DRAW, ROOM, DIALOG, WRAP, PATHS, PHASES};
+	// Amounts of work that are counted in each frame. TEXT_HITS and
+	// TEXT_MISSES count lookups in the cache of rendered text, and TEXT_KB is
+	// how much memory that cache is using at the end of the frame.
+	enum Counter {STEPS, RECTS, PIXELS, WRAPS, TEXT_HITS, TEXT_MISSES, TEXT_KB, COUNTERS};
+	
+	// Add the time from this object's construction to its destruction to the
+	// total for the given phase in the current frame.
+	class Timer {
+	public:
+		explicit Timer(Phase phase);
+		~Timer();
+		
+	private:
+		Phase phase;
+		chrono::steady_clock::time_point start;
+	};
+	
+	
+public:
+	// Add to one of the counters for the current frame.
+	static void Count(Counter counter, int amount = 1);
+	// Finish the current frame: save its totals and log them, then reset them.
+	static void EndFrame();
+	
+	// Show or hide the overlay.
+	static void Toggle();
+	static bool IsVisible();
+	// Draw the overlay in the top left corner of the given surface, and return
+	// the rectangle that it covers.
+	static Rect Draw(SDL_Surface *surface);
+	
+	// Log the totals for every frame to the given file. If its extension is
+	// ".json" it is written as a JSON array; otherwise, it is a CSV file.
+	static bool OpenLog(const string &path);
+	static void CloseLog();
+};
+
+
+
+#ifdef WHIMSY_STATS
+#define STATS_TIMER(phase) Stats::Timer statsTimer(Stats::phase)
+#define STATS_COUNT(counter, amount) Stats::Count(Stats::counter, amount)
+#else
+#define STATS_TIMER(phase)
+#define STATS_COUNT(counter, amount)
+#endif
+
+
+
+#endif
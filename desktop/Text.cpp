@@ -5,6 +5,7 @@ Copyright 2020 Michael Zahniser
 #include "Text.h"
 
 #include "Font.h"
+#include "Stats.h"
 
 #include <algorithm>
 
@@ -24,13 +25,18 @@ Text::Text(int width)
 // paragraph break tags.
 void Text::Wrap(const string &text)
 {
-	segments.clear();
+	STATS_TIMER(WRAP);
+	STATS_COUNT(WRAPS, 1);
+	
+	glyphs.clear();
 	
 	// Begin with the default font.
 	string style;
 	const Font *font = &Font::Get(style);
 	// The first line of text starts out at offset (0, 0).
 	Point anchor;
+	// Remember the text of the most recent segment, for kerning.
+	string previous;
 	// Iterate through the given text. Break it up into sections separated by
 	// {style} tags. If a section does not fit on a single line, break it up.
 	size_t first = 0;
@@ -39,33 +45,44 @@ void Text::Wrap(const string &text)
 		// Find the next style tag.
 		size_t last = min(text.find('{', first), text.size());
 		// Find the right place to break this line, if necessary.
-		// TODO: Find a more efficient way to do this.
 		while(first != last)
 		{
-			// First, see if the whole text will fit on one line.
-			string segment = text.substr(first, last - first);
-			if(anchor.X() && !segments.empty())
-				anchor.X() += font->Kern(segments.back().text, segment);
-			int wholeWidth = font->Width(segment);
-			if(anchor.X() + wholeWidth <= wrapWidth)
-			{
-				segments.emplace_back(segment, anchor, style);
-				anchor.X() += wholeWidth;
-				break;
-			}
-			// Scan forward to see where we need to break this string to fit it
-			// within the current line width.
+			if(anchor.X() && !previous.empty())
+				anchor.X() += font->Kern(previous, text.data() + first, text.data() + last);
+			// Walk through the text once, measuring the width up to each place
+			// where the line could be broken. Stop looking for breaks at the
+			// first one that does not fit. No advance is ever negative, so once
+			// even the minimum width is too wide, the whole text cannot fit.
+			// Only ASCII whitespace is a place to break; the bytes of a UTF-8
+			// character are never mistaken for it, because they are all 0x80
+			// or above.
+			Font::Measure measure(*font);
 			size_t wrapPos = first;
-			for(size_t i = first; i < last; ++i)
-				if(text[i] <= ' ')
+			size_t scanned = last;
+			bool isFull = false;
+			size_t i = first;
+			for( ; i < last; ++i)
+			{
+				if(!isFull && static_cast<unsigned char>(text[i]) <= ' ')
 				{
-					segment = text.substr(first, i - first);
-					int width = font->Width(segment);
-					if(anchor.X() + width <= wrapWidth)
+					scanned = i;
+					if(anchor.X() + measure.Width() <= wrapWidth)
 						wrapPos = i;
 					else
-						break;
+						isFull = true;
 				}
+				if(isFull && anchor.X() + measure.Offset() > wrapWidth)
+					break;
+				measure.Add(text[i]);
+			}
+			// See if the whole text will fit on one line.
+			if(i == last && anchor.X() + measure.Width() <= wrapWidth)
+			{
+				previous = text.substr(first, last - first);
+				font->Layout(previous, anchor, glyphs);
+				anchor.X() += measure.Width();
+				break;
+			}
 			// If there was no whitespace before the line reaches the wrap
 			// width, we may need to extend beyond the end of the line.
 			if(wrapPos == first)
@@ -81,14 +98,17 @@ void Text::Wrap(const string &text)
 				else
 					wrapPos = min(last, text.find(' ', first));
 			}
-			// Insert the segment, then move to the next line.
-			segment.resize(wrapPos - first);
-			segments.emplace_back(segment, anchor, style);
+			// Insert the segment, then move to the next line. If the segment
+			// extends past the last whitespace that was measured, the rest of
+			// it is left blank.
+			previous = text.substr(first, min(wrapPos, scanned) - first);
+			previous.resize(wrapPos - first);
+			font->Layout(previous, anchor, glyphs);
 			anchor.X() = 0;
 			anchor.Y() += lineHeight;
 			// Now, find the end of the whitespace that the wrap started at.
 			first = wrapPos;
-			while(first < last && text[first] <= ' ')
+			while(first < last && static_cast<unsigned char>(text[first]) <= ' ')
 				++first;
 		}
 		// Now, find the end of the style tag.
@@ -150,6 +170,15 @@ int Text::Height() const
 
 
 
+// Get every glyph of the currently wrapped text, relative to its top left
+// corner.
+const vector<Font::Glyph> &Text::Glyphs() const
+{
+	return glyphs;
+}
+
+
+
 // Get or set the line height.
 int Text::LineHeight() const
 {
@@ -184,9 +213,5 @@ void Text::SetParagraphSpacing(int spacing)
 // the given amount relative.
 void Text::Draw(SDL_Surface *surface, Point corner) const
 {
-	for(const Segment &segment : segments)
-	{
-		const Font &font = Font::Get(segment.style);
-		font.Draw(segment.text, corner + segment.position, surface);
-	}
+	Font::DrawCached(glyphs, corner, surface);
 }
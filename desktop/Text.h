@@ -5,6 +5,7 @@ Copyright 2020 Michael Zahniser
 #ifndef TEXT_H_
 #define TEXT_H_
 
+#include "Font.h"
 #include "Point.h"
 
 #include <SDL2/SDL.h>
@@ -16,8 +17,8 @@ using namespace std;
 
 
 
-// This class represents formatted and wrapped text broken up into segments that
-// can each be drawn with a single Font call.
+// This class represents formatted and wrapped text, laid out as a flat list of
+// glyphs so that drawing it needs no font lookups or measuring.
 class Text {
 public:
 	// Initialize a Text object, setting the font and the wrap width.
@@ -32,6 +33,9 @@ public:
 	void SetWidth(int width);
 	// Get the height of the currently wrapped text.
 	int Height() const;
+	// Get every glyph of the currently wrapped text, relative to its top left
+	// corner.
+	const vector<Font::Glyph> &Glyphs() const;
 
 	// Get or set the line height.
 	int LineHeight() const;
@@ -51,18 +55,9 @@ private:
 	int lineHeight = 20;
 	int paragraphSpacing = 10;
 
-	// Object representing a segment of text, all drawn on the same line and in
-	// the same color.
-	class Segment {
-	public:
-		Segment(string text, Point position, const string &style = "")
-			: text(text), position(position), style(style) {}
-		
-		string text;
-		Point position;
-		string style;
-	};
-	vector<Segment> segments;
+	// Every glyph of the wrapped text, in order, relative to its top left
+	// corner.
+	vector<Font::Glyph> glyphs;
 	int height;
 };
 
@@ -0,0 +1,133 @@
+/* Trace.cpp
+Copyright 2020 Michael Zahniser
+*/
+
+#include "Trace.h"
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace {
+	// Whether a trace is being recorded. This is checked without locking,
+	// so that spans cost almost nothing if tracing is off.
+	atomic<bool> isOpen(false);
+	// Everything below is guarded by the mutex.
+	mutex fileLock;
+	ofstream out;
+	chrono::steady_clock::time_point epoch;
+	bool isFirst = true;
+	// Small numbers for each thread, in the order they first record a span.
+	// The thread that opened the trace is thread 1.
+	map<thread::id, int> threads;
+	
+	// Escape a string for use in JSON.
+	string Escape(const string &text)
+	{
+		string result;
+		for(char c : text)
+		{
+			if(c == '"' || c == '\\')
+				result += '\\';
+			if(static_cast<unsigned char>(c) >= ' ')
+				result += c;
+		}
+		return result;
+	}
+	
+	// Get the number for the current thread. The mutex must be locked.
+	int ThreadID()
+	{
+		int &id = threads[this_thread::get_id()];
+		if(!id)
+			id = threads.size();
+		return id;
+	}
+}
+
+
+
+// Record the time from this object's construction to its destruction. The
+// name must be a string constant. The detail, if any, is shown in the
+// span's arguments, e.g. to say which file was being loaded.
+Trace::Span::Span(const char *name, const string &detail)
+	: name(name)
+{
+	if(!isOpen)
+		return;
+	
+	this->detail = detail;
+	start = chrono::steady_clock::now();
+}
+
+
+
+Trace::Span::~Span()
+{
+	if(!isOpen)
+		return;
+	
+	// Each span is written as one "complete" event, with a duration.
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	lock_guard<mutex> guard(fileLock);
+	// The trace may have started or stopped while this span was open.
+	if(!isOpen || start < epoch)
+		return;
+	
+	chrono::duration<double, micro> timestamp = start - epoch;
+	chrono::duration<double, micro> duration = end - start;
+	out << (isFirst ? "" : ",\n")
+		<< "{\"name\": \"" << name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << ThreadID()
+		<< ", \"ts\": " << timestamp.count() << ", \"dur\": " << duration.count();
+	if(!detail.empty())
+		out << ", \"args\": {\"detail\": \"" << Escape(detail) << "\"}";
+	out << '}';
+	isFirst = false;
+}
+
+
+
+// Begin writing a trace to the given file. Returns false if the file
+// could not be opened.
+bool Trace::Open(const string &path)
+{
+	Close();
+	
+	lock_guard<mutex> guard(fileLock);
+	out.open(path);
+	if(!out)
+		return false;
+	
+	out << "{\"traceEvents\": [\n";
+	epoch = chrono::steady_clock::now();
+	isFirst = true;
+	threads.clear();
+	ThreadID();
+	isOpen = true;
+	return true;
+}
+
+
+
+// Finish writing the trace file, if one is open.
+void Trace::Close()
+{
+	lock_guard<mutex> guard(fileLock);
+	if(!isOpen)
+		return;
+	
+	isOpen = false;
+	out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+	out.close();
+}
+
+
+
+bool Trace::IsOpen()
+{
+	return isOpen;
+}
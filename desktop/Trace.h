@@ -0,0 +1,48 @@
+/* Trace.h
+Copyright 2020 Michael Zahniser
+*/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+
+
+// Optional trace of how long the engine spends in its slowest operations, in
+// the Chrome trace event format. The file can be opened in chrome://tracing or
+// in Perfetto. Spans can be recorded from any thread, and each is tagged with
+// the thread it ran on. If tracing has not been started, recording a span does
+// nothing but check a flag.
+class Trace {
+public:
+	// Record the time from this object's construction to its destruction. The
+	// name must be a string constant. The detail, if any, is shown in the
+	// span's arguments, e.g. to say which file was being loaded.
+	class Span {
+	public:
+		explicit Span(const char *name, const string &detail = "");
+		~Span();
+		
+	private:
+		const char *name;
+		string detail;
+		chrono::steady_clock::time_point start;
+	};
+	
+	
+public:
+	// Begin writing a trace to the given file. Returns false if the file
+	// could not be opened.
+	static bool Open(const string &path);
+	// Finish writing the trace file, if one is open.
+	static void Close();
+	static bool IsOpen();
+};
+
+
+
+#endif
@@ -9,6 +9,8 @@ Copyright 2020 Michael Zahniser
 #include "Menu.h"
 #include "Room.h"
 #include "Sprite.h"
+#include "Stats.h"
+#include "Trace.h"
 #include "Variables.h"
 
 #include <cmath>
@@ -22,10 +24,40 @@ namespace {
 	string savePath;
 	// Configuration options:
 	int frameRate = 8;
+	int animationRate = 0;
 	
 	// Store two vectors of rooms: one with their initial states, and one with
 	// any changes that have occurred due to in-game events.
 	map<string, Room> roomInit;
+	
+	// Clip the given rectangles to the screen, drop any that are empty, and
+	// merge any that overlap so that no pixel is painted more than once.
+	void Merge(vector<Rect> &rects, Point size)
+	{
+		Rect screen(0, 0, size.X(), size.Y());
+		vector<Rect> merged;
+		for(Rect rect : rects)
+		{
+			if(!SDL_IntersectRect(&rect, &screen, &rect))
+				continue;
+			
+			// Each time this rectangle grows, it may begin to overlap one of
+			// the rectangles that have already been merged.
+			for(size_t i = 0; i < merged.size(); )
+			{
+				if(merged[i].Overlaps(rect))
+				{
+					SDL_UnionRect(&rect, &merged[i], &rect);
+					merged.erase(merged.begin() + i);
+					i = 0;
+				}
+				else
+					++i;
+			}
+			merged.push_back(rect);
+		}
+		rects.swap(merged);
+	}
 }
 
 
@@ -36,7 +68,7 @@ string World::LoadConfig(Data &data)
 {
 	// When this function is called, the Data object must be at the start of
 	// the data file, at a "game" line.
-	if(data.Tag() != "game")
+	if(data.Key() != Data::GAME)
 		return "";
 	string title = data.Value();
 	
@@ -53,15 +85,36 @@ string World::LoadConfig(Data &data)
 	
 	while(data.Next() && data.Size())
 	{
-		if(data.Tag() == "fps")
-			frameRate = data[1];
+		switch(data.Key())
+		{
+			case Data::FPS:
+				frameRate = data[1];
+				break;
+			case Data::ANIMATION:
+				animationRate = data[1];
+				break;
+			default:
+				break;
+		}
 	}
+	// By default, sprites are animated at the same rate as the simulation.
+	if(!animationRate)
+		animationRate = frameRate;
 	return title;
 }
 
 
 
-// Configuration options:
+// Get the path to the saved game file.
+const string &World::SavePath()
+{
+	return savePath;
+}
+
+
+
+// Configuration options: the number of simulation steps per second, and
+// the number of sprite animation frames per second.
 int World::FrameRate()
 {
 	return frameRate;
@@ -69,30 +122,51 @@ int World::FrameRate()
 
 
 
+int World::AnimationRate()
+{
+	return animationRate;
+}
+
+
+
 // Load all the data from the given file.
 void World::Load(Data &data)
 {
+	Trace::Span span("World::Load");
+	
 	// Load the sprite sheets.
 	for( ; data; data.Next())
 	{
-		if(data.Tag() == "index")
-			Sprite::SetIndex(data);
-		else if(data.Tag() == "sheet")
-			Sprite::LoadSheet(data);
-		else if(data.Tag() == "sprite")
-			Sprite::Add(data);
-		else if(data.Tag() == "style")
-			Font::Add(data);
-		else if(data.Tag() == "menu")
-			Menu::Add(data);
-		else if(data.Tag() == "avatar")
-			Avatar::Load(data);
-		else if(data.Tag() == "init")
-			Dialog::Load(data);
-		else if(data.Tag() == "dialog")
-			Dialog::Load(data);
-		else if(data.Tag() == "room")
-			roomInit[data.Value()].Load(data);
+		switch(data.Key())
+		{
+			case Data::INDEX:
+				Sprite::SetIndex(data);
+				break;
+			case Data::SHEET:
+				Sprite::LoadSheet(data);
+				break;
+			case Data::SPRITE:
+				Sprite::Add(data);
+				break;
+			case Data::STYLE:
+				Font::Add(data);
+				break;
+			case Data::MENU:
+				Menu::Add(data);
+				break;
+			case Data::AVATAR:
+				Avatar::Load(data);
+				break;
+			case Data::INIT:
+			case Data::DIALOG:
+				Dialog::Load(data);
+				break;
+			case Data::ROOM:
+				roomInit[data.Value()].Load(data);
+				break;
+			default:
+				break;
+		}
 	}
 }
 
@@ -126,7 +200,7 @@ bool World::Init()
 		return false;
 	
 	string line;
-	static vector<string> lines;
+	vector<string> lines;
 	while(getline(in, line))
 		lines.push_back(line);
 	
@@ -173,24 +247,80 @@ void World::Save()
 
 
 // Draw the world. Use the given mouse position to check if any of the
-// interaction icons are hovered over.
-void World::Draw(SDL_Surface *screen, Point hover) const
+// interaction icons are hovered over. Only the parts of the screen that
+// may have changed since the last call are repainted; their rectangles are
+// stored in the given vector, which is empty if nothing was drawn.
+void World::Draw(SDL_Surface *screen, Point hover, vector<Rect> &damage) const
 {
+	STATS_TIMER(DRAW);
+	
 	// Note: this function will never be called unless the world is "loaded,"
 	// meaning that the avatar is in a valid room.
-	Room &room = *avatar.Location();
+	const Room &room = *avatar.Location();
 	
-	// Insert the avatar into the room, then draw it, then remove the avatar.
 	int sprite = avatar.SpriteIndex();
 	viewOffset = Point(
 		screen->w, screen->h - Sprite::Get(sprite).Bounds().y) / -2;
-	int index = room.Add(sprite, avatar.Position());
-	room.Draw(screen, avatar.Position() + viewOffset, hover, !dialog.IsOpen());
-	room.Remove(index);
+	Point view = drawn + viewOffset;
+	Point size(screen->w, screen->h);
 	
-	// Draw the dialog overlay.
-	if(dialog.IsOpen())
-		dialog.Draw(screen, hover);
+	// The avatar and the interaction icons may change from frame to frame, so
+	// both their current and their previous rectangles must be repainted.
+	vector<Rect> moving;
+	moving.push_back(Sprite::Get(sprite).Bounds() + drawn - view);
+	room.Damage(view, size, moving);
+	
+	// The view is centered on the avatar, so if the avatar moved the entire
+	// screen must be repainted.
+	damage.clear();
+	bool repaintAll = (mustRepaint || view != lastView || size != lastSize || dialog.IsOpen() != lastDialog);
+	if(repaintAll)
+		damage.emplace_back(0, 0, size.X(), size.Y());
+	else
+	{
+		damage = lastMoving;
+		damage.insert(damage.end(), moving.begin(), moving.end());
+		if(dialog.IsOpen())
+			dialog.Damage(damage);
+		Merge(damage, size);
+	}
+	mustRepaint = false;
+	lastView = view;
+	lastSize = size;
+	lastDialog = dialog.IsOpen();
+	lastMoving.swap(moving);
+	
+	// The avatar is drawn as an "actor," merged into the room's sprites.
+	const vector<Room::Entry> actors = {Room::Entry(sprite, drawn, "")};
+	// The dialog overlay only has to be drawn again in the rectangles that it
+	// covers. If the whole screen is repainted, its layout may have changed.
+	vector<Rect> dialogRects;
+	if(dialog.IsOpen() && !repaintAll)
+		dialog.Damage(dialogRects);
+	STATS_COUNT(RECTS, damage.size());
+	for(const Rect &rect : damage)
+	{
+		STATS_COUNT(PIXELS, rect.w * rect.h);
+		SDL_SetClipRect(screen, &rect);
+		room.Draw(screen, view, hover, !dialog.IsOpen(), actors);
+		
+		// Draw the dialog overlay.
+		bool coversDialog = repaintAll;
+		for(const Rect &it : dialogRects)
+			coversDialog |= SDL_HasIntersection(&rect, &it);
+		if(dialog.IsOpen() && coversDialog)
+			dialog.Draw(screen, hover);
+	}
+	SDL_SetClipRect(screen, nullptr);
+}
+
+
+
+// Make the next Draw() repaint the entire screen, e.g. because something
+// else has been drawn over it.
+void World::Invalidate()
+{
+	mustRepaint = true;
 }
 
 
@@ -198,9 +328,15 @@ void World::Draw(SDL_Surface *screen, Point hover) const
 // Handle an event, and return true if the screen must be redrawn.
 bool World::Handle(const SDL_Event &event)
 {
-	// If the dialog is open, it "traps" all events.
+	// If the dialog is open, it "traps" all events. Anything other than a
+	// change in which option is hovered over may change the dialog's layout.
 	if(dialog.IsOpen())
-		return dialog.Handle(event);
+	{
+		bool changed = dialog.Handle(event);
+		if(changed && event.type != SDL_MOUSEMOTION)
+			Invalidate();
+		return changed;
+	}
 	
 	// Note: this function will never be called unless the world is "loaded,"
 	// meaning that the avatar is in a valid room.
@@ -208,7 +344,7 @@ bool World::Handle(const SDL_Event &event)
 	
 	if(event.type == SDL_MOUSEBUTTONDOWN)
 	{
-		Point target = Point(event.button.x, event.button.y) + avatar.Position() + viewOffset;
+		Point target = Point(event.button.x, event.button.y) + drawn + viewOffset;
 		const Interaction *interaction = room.Button(target);
 		if(interaction)
 		{
@@ -224,7 +360,7 @@ bool World::Handle(const SDL_Event &event)
 	else if(event.type == SDL_MOUSEMOTION)
 	{
 		// Check if the hover state of any interaction icon should change.
-		Point target = Point(event.motion.x, event.motion.y) + avatar.Position() + viewOffset;
+		Point target = Point(event.motion.x, event.motion.y) + drawn + viewOffset;
 		Point previous = target - Point(event.motion.xrel, event.motion.yrel);
 		
 		if(room.Button(target) != room.Button(previous))
@@ -236,14 +372,24 @@ bool World::Handle(const SDL_Event &event)
 
 
 
-// Step forward one frame, moving the avatar and checking interactions.
-void World::Step()
+// Step the simulation forward, moving the avatar and checking interactions.
+// Return true if anything visible may have changed.
+bool World::Step()
 {
+	STATS_TIMER(STEP);
+	STATS_COUNT(STEPS, 1);
+	
+	// If the avatar does not move in this step, it should be drawn exactly
+	// where it is now.
+	previous = avatar.Position();
+	
 	// If the dialog is open, the world is "paused."
 	if(dialog.IsOpen())
-		return;
+		return false;
 	
+	bool changed = false;
 	Point position = avatar.Position();
+	int sprite = avatar.SpriteIndex();
 	
 	// If we're here, the path must not be empty. But, we do need to check
 	// if the avatar has reached one of the waypoints.
@@ -266,14 +412,67 @@ void World::Step()
 		}
 	}
 	// Move the avatar to the calculated position.
+	changed |= (position != avatar.Position());
 	avatar.Move(position);
+	changed |= (sprite != avatar.SpriteIndex());
 	
 	// Check what interaction zone states have changed. If any change, nothing
-	// needs to be done here unless they're "immediate" interactions.
+	// needs to be done here unless they're "immediate" interactions. Either
+	// way, the interaction icons may have changed.
+	mustStep = false;
 	Room &room = *avatar.Location();
 	for(Interaction &it : room.Interactions())
+	{
+		int state = it.State();
 		if(it.SetState(position) == Interaction::IMMEDIATE)
+		{
 			Trigger(it);
+			changed = true;
+		}
+		else
+			changed |= (it.State() != state);
+	}
+	return changed;
+}
+
+
+
+// Set how far the simulation is between the last Step() and the next one,
+// from 0 to 1. The avatar is drawn that far between its positions before
+// and after the last step. Return true if that moves it on the screen.
+bool World::Interpolate(double fraction)
+{
+	Point delta = avatar.Position() - previous;
+	Point point = previous + Point(round(delta.X() * fraction), round(delta.Y() * fraction));
+	bool changed = (point != drawn);
+	drawn = point;
+	return changed;
+}
+
+
+
+// Check if calling Step() might change anything.
+bool World::IsMoving() const
+{
+	if(!avatar.Location())
+		return false;
+	// Even if the world is paused, the avatar must catch up to where it is.
+	if(drawn != avatar.Position())
+		return true;
+	
+	return !dialog.IsOpen() && (mustStep || !path.empty());
+}
+
+
+
+// Check if any animated sprites are in view.
+bool World::IsAnimated() const
+{
+	if(!avatar.Location())
+		return false;
+	
+	return Sprite::Get(avatar.SpriteIndex()).IsAnimated()
+		|| avatar.Location()->IsAnimated(lastView, lastSize);
 }
 
 
@@ -282,14 +481,23 @@ void World::Step()
 // to certain events.
 void World::Enter(Point position, const string &room)
 {
-	// If we're moving to a new room, clear interaction states in the old one.
+	Trace::Span span("World::Enter", room);
+	
+	// If we're moving to a new room, clear interaction states in the old one,
+	// and free its cached images.
 	if(!room.empty() && avatar.Location())
+	{
 		for(Interaction &it : avatar.Location()->Interactions())
 			it.ClearState();
+		avatar.Location()->FreeCache();
+	}
 	
 	// Move the avatar to the new room, if one is given.
 	map<string, Room>::iterator it = rooms.find(room);
 	avatar.Enter(position, it == rooms.end() ? nullptr : &it->second);
+	// Jump straight to the new position instead of sliding to it.
+	previous = drawn = avatar.Position();
+	Invalidate();
 	
 	// An enter event should always interrupt movement and redo pathfinding.
 	// Even if we're in the same room, we may be in a different, disjoint
@@ -324,6 +532,7 @@ void World::Add(int sprite, Point center, const string &name, const string &room
 		return;
 	
 	location->Add(sprite, center, name);
+	Invalidate();
 	changes << "add " << location->Name() << '\n' << "  " << sprite << " " << center;
 	if(!name.empty())
 		changes << " " << name;
@@ -341,6 +550,9 @@ void World::Add(const Interaction &interaction, const string &room)
 		return;
 	
 	location->Add(interaction);
+	Invalidate();
+	// The new interaction's state is set on the next step.
+	mustStep = true;
 	changes << "add " << location->Name() << '\n';
 	interaction.Save(changes, "  ");
 }
@@ -356,6 +568,7 @@ void World::Remove(const string &name, const string &room)
 		return;
 	
 	location->Remove(name);
+	Invalidate();
 	changes << "remove " << location->Name() << '\n' << "  " << name << '\n';
 }
 
@@ -370,6 +583,8 @@ void World::Reset()
 	changes.clear();
 	path.clear();
 	dialog.Close();
+	Invalidate();
+	mustStep = true;
 }
 
 
@@ -378,6 +593,8 @@ void World::Reset()
 // pathfinding and return true; otherwise return false;
 bool World::InitPathfinding()
 {
+	Trace::Span span("World::InitPathfinding");
+	
 	if(!avatar.Location())
 		return false;
 	
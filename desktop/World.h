@@ -11,6 +11,7 @@ Copyright 2020 Michael Zahniser
 #include "Interaction.h"
 #include "Paths.h"
 #include "Point.h"
+#include "Rect.h"
 
 #include <SDL2/SDL.h>
 
@@ -28,8 +29,12 @@ public:
 	// Parse the game configuration and return the title of the game. If the
 	// returned string is empty, parsing the configuration failed.
 	static string LoadConfig(Data &data);
-	// Configuration options:
+	// Get the path to the saved game file.
+	static const string &SavePath();
+	// Configuration options: the number of simulation steps per second, and
+	// the number of sprite animation frames per second.
 	static int FrameRate();
+	static int AnimationRate();
 	
 	// Load all the data from the given file.
 	static void Load(Data &data);
@@ -49,13 +54,31 @@ public:
 	void Save();
 	
 	// Draw the world. Use the given mouse position to check if any of the
-	// interaction icons are hovered over.
-	void Draw(SDL_Surface *screen, Point hover) const;
+	// interaction icons are hovered over. Only the parts of the screen that
+	// may have changed since the last call are repainted; their rectangles are
+	// stored in the given vector, which is empty if nothing was drawn.
+	void Draw(SDL_Surface *screen, Point hover, vector<Rect> &damage) const;
+	// Make the next Draw() repaint the entire screen, e.g. because something
+	// else has been drawn over it.
+	void Invalidate();
 	// Handle an event, and return true if the screen must be redrawn.
 	bool Handle(const SDL_Event &event);
 	
-	// Step forward one frame, moving the avatar and checking interactions.
-	void Step();
+	// Step the simulation forward, moving the avatar and checking interactions.
+	// Return true if anything visible may have changed.
+	bool Step();
+	// Set how far the simulation is between the last Step() and the next one,
+	// from 0 to 1. The avatar is drawn that far between its positions before
+	// and after the last step. Return true if that moves it on the screen.
+	bool Interpolate(double fraction);
+	// Check if calling Step() might change anything: the avatar is walking or
+	// is not yet drawn where it stopped, or interactions have been added
+	// whose state has not been checked yet. If not, there is no need to call
+	// Step() until an event changes that.
+	bool IsMoving() const;
+	// Check if any animated sprites are in view, i.e. if the screen must be
+	// redrawn after each Sprite::Step().
+	bool IsAnimated() const;
 	
 	// These functions are used by Dialog to change the game world in response
 	// to certain events.
@@ -98,13 +121,26 @@ private:
 	
 	// Current avatar location.
 	Avatar avatar;
+	// Where the avatar was before the last Step(), and where it is drawn.
+	Point previous;
+	Point drawn;
 	// Offset to use to center the avatar in the view. This is calculated based
 	// on the size of the view and the size of the avatar sprite.
 	mutable Point viewOffset;
 	
+	// State of the previous Draw(), used to decide what must be repainted.
+	mutable bool mustRepaint = true;
+	mutable Point lastView;
+	mutable Point lastSize;
+	mutable bool lastDialog = false;
+	mutable vector<Rect> lastMoving;
+	
 	// Pathfinding.
 	Paths paths;
 	vector<Point> path;
+	// Whether the interaction states must be checked on the next Step() even
+	// if the avatar does not move.
+	bool mustStep = true;
 };
 
 
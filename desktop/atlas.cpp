@@ -0,0 +1,460 @@
+/* atlas.cpp
+Copyright 2020 Michael Zahniser
+
+Program to pack the sprites from a set of sprite definition files into as few
+sprite sheets ("atlases") as possible. Like the mask editor, this assumes that
+each text file contains nothing but "sheet" commands and sprite definitions.
+
+Each sprite's frames are trimmed of any transparent border they all share, and
+then packed into rows ("shelves") in the atlases, tallest first. The rewritten
+sprite files are saved in the output directory, along with the atlas images,
+and can be loaded in place of the originals. The bounds, baseline, and mask of
+each sprite are adjusted so that it is still drawn in exactly the same place.
+Because a sprite's anchor is the horizontal center of its first frame (and the
+vertical center, if it has no baseline), borders are trimmed by the same amount
+on both sides. Trimming does make each sprite's bounding box smaller, which
+also affects where it can be clicked on, and the layout of dialogs that show
+it. Use --no-trim to only pack the sprites.
+
+Usage: atlas [--size <atlas width>] [--no-trim] <output directory> <sprite file>...
+*/
+
+#include "Data.h"
+#include "Point.h"
+#include "Rect.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Default width (and maximum height) of an atlas.
+	const int DEFAULT_SIZE = 2048;
+	// Empty space to leave between frames, so that scaled drawing does not
+	// pick up pixels from neighboring frames.
+	const int PADDING = 1;
+	
+	// A sprite definition, and where its frames go in the atlas.
+	class Sprite {
+	public:
+		// Copy of the sprite's sheet, in ARGB8888 format.
+		SDL_Surface *sheet = nullptr;
+		// The lines of the definition, not including the "sprite" line.
+		vector<string> lines;
+		// Where each frame is in the original sheet.
+		vector<Rect> frames;
+		bool hasBaseline = false;
+		// The part of each frame that is kept, relative to its corner.
+		Rect trim;
+		// The frames are arranged in a grid with this many columns.
+		int columns = 1;
+		// Which atlas the frames are in, and the corner of the first frame.
+		int atlas = -1;
+		Point corner;
+		
+		// Get the size of the block of frames.
+		Point Size() const;
+		// Get the position of the given frame in the atlas.
+		Point Frame(int index) const;
+	};
+	
+	// A sprite definition file.
+	class File {
+	public:
+		string name;
+		vector<Sprite> sprites;
+	};
+	
+	// A row of frames within an atlas.
+	class Shelf {
+	public:
+		int y;
+		int height;
+		int used;
+	};
+	
+	// One atlas image.
+	class Atlas {
+	public:
+		Atlas(int width, int height);
+		
+		// Find a place for a block of the given size. Return false if there is
+		// no room for it in this atlas.
+		bool Place(Point size, Point &corner);
+		// Get the size of the area that is actually used.
+		Point Used() const;
+		
+		int width;
+		int height;
+		int bottom = 0;
+		vector<Shelf> shelves;
+	};
+	
+	// Get the name of the given atlas image.
+	string AtlasName(int index);
+	// Load a sprite sheet, converted to ARGB8888.
+	SDL_Surface *LoadSheet(const string &path);
+	// Read the given sprite definition file.
+	bool Load(const string &path, File &file);
+	// Find the part of each of this sprite's frames to keep.
+	void Trim(Sprite &sprite);
+	// Write a sprite definition file, with the sprites moved to the atlas.
+	bool Save(const string &path, const File &file);
+	
+	// Sheets that have been loaded, by path.
+	map<string, SDL_Surface *> sheets;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	int size = DEFAULT_SIZE;
+	bool shouldTrim = true;
+	int arg = 1;
+	for( ; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		string option = argv[arg];
+		if(option == "--size" && arg + 1 < argc)
+			size = max(1, atoi(argv[++arg]));
+		else if(option == "--no-trim")
+			shouldTrim = false;
+		else
+			break;
+	}
+	if(argc - arg < 2)
+	{
+		cerr << "Usage: $ ./atlas [--size <atlas width>] [--no-trim] <output directory> <sprite file>..." << endl;
+		return 1;
+	}
+	string directory = argv[arg++];
+	if(directory.back() != '/')
+		directory += '/';
+	
+	SDL_Init(0);
+	IMG_Init(IMG_INIT_PNG);
+	
+	// Load all the sprite definitions.
+	vector<File> files(argc - arg);
+	for(size_t i = 0; i < files.size(); ++i)
+		if(!Load(argv[arg + i], files[i]))
+			return 1;
+	
+	// Figure out how much of each sprite to keep, and how to lay out its frames.
+	vector<Sprite *> sprites;
+	for(File &file : files)
+		for(Sprite &sprite : file.sprites)
+		{
+			sprite.trim = Rect(0, 0, sprite.frames.front().w, sprite.frames.front().h);
+			if(shouldTrim)
+				Trim(sprite);
+			int count = sprite.frames.size();
+			sprite.columns = max(1, min(count, (size + PADDING) / (sprite.trim.w + PADDING)));
+			sprites.push_back(&sprite);
+		}
+	
+	// Pack the sprites, tallest first. Each one goes in the first place that
+	// it fits. If it doesn't fit anywhere, start a new atlas.
+	stable_sort(sprites.begin(), sprites.end(), [](const Sprite *a, const Sprite *b)
+	{
+		return (a->Size().Y() > b->Size().Y() || (a->Size().Y() == b->Size().Y() && a->Size().X() > b->Size().X()));
+	});
+	vector<Atlas> atlases;
+	for(Sprite *sprite : sprites)
+	{
+		for(size_t i = 0; i < atlases.size() && sprite->atlas < 0; ++i)
+			if(atlases[i].Place(sprite->Size(), sprite->corner))
+				sprite->atlas = i;
+		if(sprite->atlas >= 0)
+			continue;
+		
+		// A sprite that is bigger than an atlas gets an atlas of its own.
+		atlases.emplace_back(max(size, sprite->Size().X()), max(size, sprite->Size().Y()));
+		atlases.back().Place(sprite->Size(), sprite->corner);
+		sprite->atlas = atlases.size() - 1;
+	}
+	
+	// Draw and save the atlases.
+	int64_t before = 0;
+	for(const auto &it : sheets)
+		if(it.second)
+			before += it.second->w * it.second->h;
+	int64_t after = 0;
+	for(size_t i = 0; i < atlases.size(); ++i)
+	{
+		Point used = atlases[i].Used();
+		after += used.X() * used.Y();
+		SDL_Surface *image = SDL_CreateRGBSurfaceWithFormat(0, used.X(), used.Y(), 32, SDL_PIXELFORMAT_ARGB8888);
+		if(!image)
+		{
+			cerr << "Unable to create an atlas of size " << used.X() << "x" << used.Y() << "." << endl;
+			return 1;
+		}
+		for(const Sprite *sprite : sprites)
+			if(sprite->atlas == static_cast<int>(i))
+				for(size_t frame = 0; frame < sprite->frames.size(); ++frame)
+				{
+					Rect from = sprite->trim + sprite->frames[frame].TopLeft();
+					Rect to(sprite->Frame(frame), sprite->Frame(frame) + sprite->trim.Size());
+					SDL_BlitSurface(sprite->sheet, &from, image, &to);
+				}
+		
+		string path = directory + AtlasName(i);
+		if(IMG_SavePNG(image, path.c_str()))
+		{
+			cerr << "Unable to save \"" << path << "\"." << endl;
+			return 1;
+		}
+		SDL_FreeSurface(image);
+	}
+	
+	// Write the updated sprite definitions.
+	for(const File &file : files)
+		if(!Save(directory + file.name, file))
+			return 1;
+	
+	cout << "Packed " << sprites.size() << " sprites from " << sheets.size() << " sheets ("
+		<< before << " pixels) into " << atlases.size() << " atlases (" << after << " pixels)." << endl;
+	
+	for(const auto &it : sheets)
+		if(it.second)
+			SDL_FreeSurface(it.second);
+	IMG_Quit();
+	SDL_Quit();
+	return 0;
+}
+
+
+
+namespace {
+	// Get the size of the block of frames.
+	Point Sprite::Size() const
+	{
+		int count = frames.size();
+		int rows = (count + columns - 1) / columns;
+		return Point(columns * (trim.w + PADDING) - PADDING, rows * (trim.h + PADDING) - PADDING);
+	}
+	
+	// Get the position of the given frame in the atlas.
+	Point Sprite::Frame(int index) const
+	{
+		return corner + Point((index % columns) * (trim.w + PADDING), (index / columns) * (trim.h + PADDING));
+	}
+	
+	Atlas::Atlas(int width, int height)
+		: width(width), height(height)
+	{
+	}
+	
+	// Find a place for a block of the given size.
+	bool Atlas::Place(Point size, Point &corner)
+	{
+		// The blocks are placed from tallest to shortest, so any existing shelf
+		// is tall enough for this one.
+		for(Shelf &shelf : shelves)
+			if(size.Y() <= shelf.height && shelf.used + size.X() <= width)
+			{
+				corner = Point(shelf.used, shelf.y);
+				shelf.used += size.X() + PADDING;
+				return true;
+			}
+		
+		if(size.X() > width || bottom + size.Y() > height)
+			return false;
+		corner = Point(0, bottom);
+		shelves.push_back(Shelf{bottom, size.Y(), size.X() + PADDING});
+		bottom += size.Y() + PADDING;
+		return true;
+	}
+	
+	// Get the size of the area that is actually used.
+	Point Atlas::Used() const
+	{
+		int used = 0;
+		for(const Shelf &shelf : shelves)
+			used = max(used, shelf.used);
+		return Point(max(1, used - PADDING), max(1, bottom - PADDING));
+	}
+	
+	// Get the name of the given atlas image.
+	string AtlasName(int index)
+	{
+		return "atlas-" + to_string(index) + ".png";
+	}
+	
+	// Load a sprite sheet, converted to ARGB8888.
+	SDL_Surface *LoadSheet(const string &path)
+	{
+		SDL_Surface *&sheet = sheets[path];
+		if(!sheet)
+		{
+			SDL_Surface *loaded = IMG_Load(path.c_str());
+			if(!loaded)
+				return nullptr;
+			sheet = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+			SDL_FreeSurface(loaded);
+			if(sheet)
+				SDL_SetSurfaceBlendMode(sheet, SDL_BLENDMODE_NONE);
+		}
+		return sheet;
+	}
+	
+	// Read the given sprite definition file.
+	bool Load(const string &path, File &file)
+	{
+		file.name = path.substr(path.rfind('/') + 1);
+		SDL_Surface *sheet = nullptr;
+		for(Data data(path); data; data.Next())
+		{
+			if(data.Key() == Data::SHEET)
+			{
+				string sheetPath = data.Directory() + data.Value();
+				sheet = LoadSheet(sheetPath);
+				if(!sheet)
+				{
+					cerr << "Unable to load \"" << sheetPath << "\"." << endl;
+					return false;
+				}
+			}
+			else if(data.Key() == Data::SPRITE)
+			{
+				file.sprites.emplace_back();
+				Sprite &sprite = file.sprites.back();
+				sprite.sheet = sheet;
+				while(data.Next() && data.Size())
+				{
+					sprite.lines.emplace_back(data.Line());
+					if(data.Key() == Data::BOUNDS && data.Size() == 3)
+					{
+						// Every frame is the same size as the first one.
+						Point a = data[1];
+						Point b = data[2];
+						if(!sprite.frames.empty())
+							b = a + sprite.frames.front().Size();
+						sprite.frames.emplace_back(a, b);
+					}
+					else if(data.Key() == Data::BASELINE)
+						sprite.hasBaseline = true;
+				}
+				if(!sprite.sheet || sprite.frames.empty())
+				{
+					cerr << path << ": sprite " << file.sprites.size() << " has no sheet or bounds." << endl;
+					return false;
+				}
+			}
+			else if(data.Size())
+				cerr << path << ": skipping line:" << data.Line() << endl;
+		}
+		return true;
+	}
+	
+	// Find the part of each of this sprite's frames to keep.
+	void Trim(Sprite &sprite)
+	{
+		// Find the smallest rectangle containing every non-transparent pixel
+		// of every frame, relative to the frame's corner.
+		const SDL_Surface *sheet = sprite.sheet;
+		int width = sprite.frames.front().w;
+		int height = sprite.frames.front().h;
+		int left = width;
+		int top = height;
+		int right = 0;
+		int bottom = 0;
+		for(const Rect &frame : sprite.frames)
+			for(int y = max(0, frame.y); y < min(sheet->h, frame.y + height); ++y)
+			{
+				const uint8_t *bytes = reinterpret_cast<const uint8_t *>(sheet->pixels) + y * sheet->pitch;
+				const uint32_t *row = reinterpret_cast<const uint32_t *>(bytes);
+				for(int x = max(0, frame.x); x < min(sheet->w, frame.x + width); ++x)
+					if(row[x] >> 24)
+					{
+						left = min(left, x - frame.x);
+						right = max(right, x - frame.x + 1);
+						top = min(top, y - frame.y);
+						bottom = max(bottom, y - frame.y + 1);
+					}
+			}
+		// Leave sprites that are completely transparent alone.
+		if(left >= right)
+			return;
+		
+		// The anchor must not move, so trim the same amount from both sides.
+		int x = min(left, width - right);
+		sprite.trim.x = x;
+		sprite.trim.w = width - 2 * x;
+		if(sprite.hasBaseline)
+		{
+			sprite.trim.y = top;
+			sprite.trim.h = bottom - top;
+		}
+		else
+		{
+			int y = min(top, height - bottom);
+			sprite.trim.y = y;
+			sprite.trim.h = height - 2 * y;
+		}
+	}
+	
+	// Write a sprite definition file, with the sprites moved to the atlas.
+	bool Save(const string &path, const File &file)
+	{
+		ofstream out(path);
+		if(!out)
+		{
+			cerr << "Unable to write \"" << path << "\"." << endl;
+			return false;
+		}
+		
+		int atlas = -1;
+		for(const Sprite &sprite : file.sprites)
+		{
+			if(sprite.atlas != atlas)
+			{
+				atlas = sprite.atlas;
+				out << "sheet " << AtlasName(atlas) << endl << endl;
+			}
+			// Anything given in sheet coordinates moves along with the first
+			// frame's trimmed area.
+			Point offset = sprite.Frame(0) - (sprite.frames.front().TopLeft() + sprite.trim.TopLeft());
+			
+			out << "sprite" << endl;
+			size_t frame = 0;
+			for(const string &line : sprite.lines)
+			{
+				Data data(vector<string>{line});
+				if(data.Key() == Data::BOUNDS && data.Size() == 3)
+				{
+					Point a = sprite.Frame(frame++);
+					Point b = a + sprite.trim.Size();
+					out << "bounds " << a.X() << "," << a.Y() << " " << b.X() << "," << b.Y() << endl;
+				}
+				else if(data.Key() == Data::BASELINE && data.Size() == 2)
+					out << "baseline " << static_cast<int>(data[1]) + offset.Y() << endl;
+				else if(data.Key() == Data::MASK)
+				{
+					out << "mask";
+					for(size_t i = 1; i < data.Size(); ++i)
+					{
+						Point point = static_cast<Point>(data[i]) + offset;
+						out << " " << point.X() << "," << point.Y();
+					}
+					out << endl;
+				}
+				else
+					out << line << endl;
+			}
+			out << endl;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,151 @@
+/* bench_compositor.cpp
+Copyright 2020 Michael Zahniser
+
+Headless benchmark for the compositor. It loads the sprites and fonts from a
+game data file, then repeatedly draws a 4K frame covered with sprites and text
+onto an offscreen surface, using different numbers of compositor threads. For
+each thread count it reports the average frame time, and whether the result is
+identical to drawing the frame without the compositor.
+
+Usage: bench_compositor [path to data.txt]
+*/
+
+#include "Compositor.h"
+#include "Data.h"
+#include "Font.h"
+#include "Point.h"
+#include "Sprite.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Size of the offscreen "window" surface.
+	const int WIDTH = 3840;
+	const int HEIGHT = 2160;
+	// Spacing of the sprites and lines of text.
+	const int SPACING = 120;
+	const int LINE_HEIGHT = 30;
+	// Number of frames to time for each thread count.
+	const int FRAMES = 20;
+	// Highest sprite index to look for.
+	const int MAX_SPRITE = 10000;
+	const string TEXT = "The quick brown fox jumps over the lazy dog. \"Whimsy\" isn't a real word, is it?";
+	
+	// Draw one frame, covering the screen with sprites and then text.
+	void Draw(SDL_Surface *screen, const vector<int> &sprites)
+	{
+		Compositor::Begin(screen);
+		Compositor::Fill(screen, nullptr, SDL_MapRGB(screen->format, 64, 64, 64));
+		size_t i = 0;
+		for(int y = 0; y < HEIGHT + SPACING; y += SPACING)
+			for(int x = 0; x < WIDTH + SPACING; x += SPACING)
+				Sprite::Get(sprites[i++ % sprites.size()]).Draw(screen, Point(x, y));
+		
+		const Font &font = Font::Get();
+		for(int y = 0; y < HEIGHT; y += LINE_HEIGHT)
+			font.Draw(TEXT, Point((y * 7) % 400, y), screen);
+		Compositor::End();
+	}
+	
+	uint32_t Checksum(SDL_Surface *screen)
+	{
+		uint32_t checksum = 0;
+		SDL_LockSurface(screen);
+		for(int y = 0; y < screen->h; ++y)
+		{
+			const uint8_t *row = reinterpret_cast<const uint8_t *>(screen->pixels) + y * screen->pitch;
+			for(int x = 0; x < screen->w * 4; ++x)
+				checksum = checksum * 31 + row[x];
+		}
+		SDL_UnlockSurface(screen);
+		return checksum;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	string path = (argc > 1 ? argv[1] : "../scenarios/woodlands/data.txt");
+	string directory = path.substr(0, path.rfind('/') + 1);
+	Font::SetDirectory(directory + "fonts/");
+	
+	SDL_Init(0);
+	IMG_Init(IMG_INIT_PNG);
+	
+	// Load the sprite and font definitions from the data file.
+	for(Data data(path); data; data.Next())
+	{
+		if(data.Key() == Data::INDEX)
+			Sprite::SetIndex(data);
+		else if(data.Key() == Data::SHEET)
+			Sprite::LoadSheet(data);
+		else if(data.Key() == Data::SPRITE)
+			Sprite::Add(data);
+		else if(data.Key() == Data::STYLE)
+			Font::Add(data);
+	}
+	vector<int> sprites;
+	for(int i = 1; i < MAX_SPRITE; ++i)
+		if(Sprite::Get(i).Width())
+			sprites.push_back(i);
+	if(sprites.empty() || !Font::IsLoaded())
+	{
+		cerr << "Unable to load the sprites and fonts." << endl;
+		return 1;
+	}
+	
+	// Most window surfaces are 32-bit XRGB.
+	SDL_Surface *screen = SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, SDL_PIXELFORMAT_RGB888);
+	if(!screen)
+	{
+		cerr << "Unable to create the offscreen surface." << endl;
+		return 1;
+	}
+	// Convert the images the same way the game does when the compositor is on.
+	Compositor::SetThreads(1);
+	Sprite::Prepare(screen->format);
+	Font::Prepare(screen->format);
+	
+	vector<int> counts = {0, 1, 2, 4, 8};
+	int hardware = thread::hardware_concurrency();
+	if(hardware > counts.back())
+		counts.push_back(hardware);
+	
+	uint32_t reference = 0;
+	for(int count : counts)
+	{
+		Compositor::SetThreads(count);
+		// Draw one frame first, so that any setup is not included in the timing.
+		Draw(screen, sprites);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for(int i = 0; i < FRAMES; ++i)
+			Draw(screen, sprites);
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		
+		uint32_t checksum = Checksum(screen);
+		if(!count)
+			reference = checksum;
+		cout << (count ? to_string(count) + " threads" : string("no compositor")) << ": "
+			<< (elapsed.count() / FRAMES) << " ms per frame"
+			<< (checksum == reference ? "" : " (output differs!)") << endl;
+	}
+	
+	Compositor::SetThreads(0);
+	SDL_FreeSurface(screen);
+	Sprite::FreeAll();
+	Font::FreeAll();
+	IMG_Quit();
+	SDL_Quit();
+	return 0;
+}
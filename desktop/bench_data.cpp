@@ -0,0 +1,126 @@
+/* bench_data.cpp
+Copyright 2020 Michael Zahniser
+
+Benchmark for loading data files. It writes a synthetic scenario of about
+100,000 lines, with rooms, interactions, and dialog in the same format as a
+real game's data, then times reading it three ways: just tokenizing every
+line, dispatching on each line's tag by comparing Tag() to each keyword in
+turn the way the loaders used to, and looking up Key(), which the loaders now
+switch on. Both ways should count the same number of each keyword.
+
+Usage: bench_data [path to write the synthetic data to]
+*/
+
+#include "Data.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Number of lines of data to generate.
+	const int LINES = 100000;
+	// Number of times to read the data each way.
+	const int PASSES = 20;
+	// The keywords, in the order a chain of comparisons would check them.
+	const vector<pair<string, Data::Keyword>> CHAIN = {
+		{"room", Data::ROOM}, {"background", Data::BACKGROUND},
+		{"interaction", Data::INTERACTION}, {"position", Data::POSITION},
+		{"offset", Data::OFFSET}, {"visible", Data::VISIBLE},
+		{"active", Data::ACTIVE}, {"enter", Data::ENTER},
+		{"dialog", Data::DIALOG}, {"goto", Data::GOTO}, {"if", Data::IF},
+		{"else", Data::ELSE}, {"option", Data::OPTION}, {"exit", Data::EXIT},
+		{"icon", Data::ICON}, {"scene", Data::SCENE}, {"add", Data::ADD},
+		{"remove", Data::REMOVE}, {"face", Data::FACE}, {"set", Data::SET},
+		{"say", Data::SAY}};
+	
+	// Write a synthetic scenario with at least the given number of lines.
+	void Generate(const string &path, int lines)
+	{
+		ofstream out(path);
+		for(int i = 0, count = 0; count < lines; ++i)
+		{
+			out << "room room" << i << '\n'
+				<< "\tbackground 40 60 30\n";
+			for(int j = 0; j < 6; ++j)
+				out << '\t' << (1000 + j) << ' ' << (i * 37 + j * 101) % 2000 << ',' << (i * 53 + j * 71) % 1000 << '\n';
+			out << "\tinteraction door" << i << '\n'
+				<< "\t\tposition " << i % 500 << ",200\n"
+				<< "\t\tvisible 80 12\n"
+				<< "\t\tactive 40 13 14\n"
+				<< "\t\tdialog talk" << i << '\n'
+				<< '\n'
+				<< "dialog talk" << i << '\n'
+				<< "\tsay The quick brown fox jumps over the lazy dog.\n"
+				<< "\tif visits" << i << " > 2\n"
+				<< "\t\tsay You have been here before.\n"
+				<< "\telse\n"
+				<< "\t\tset visits" << i << " += 1\n"
+				<< "\toption talk" << (i + 1) << '\n'
+				<< "\texit Goodbye.\n"
+				<< '\n';
+			count += 22;
+		}
+	}
+	
+	// Read the data with the given function called for each line, and report
+	// how long it took.
+	template <class Function>
+	void Time(const string &path, const string &name, Function dispatch)
+	{
+		size_t lines = 0;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for(int pass = 0; pass < PASSES; ++pass)
+			for(Data data(path); data; data.Next())
+			{
+				dispatch(data);
+				++lines;
+			}
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		
+		cout << name << ": " << (elapsed.count() / PASSES) << " ms per load, "
+			<< (lines / PASSES) / (elapsed.count() / PASSES) << " lines per ms" << endl;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	string path = (argc > 1 ? argv[1] : "bench_data.txt");
+	Generate(path, LINES);
+	
+	size_t tokens = 0;
+	Time(path, "Tokenize", [&tokens](const Data &data)
+	{
+		tokens += data.Size();
+	});
+	
+	// Count how many times each keyword appears, each way.
+	vector<size_t> byString(Data::KEYWORDS);
+	Time(path, "Compare Tag() strings", [&byString](const Data &data)
+	{
+		for(const pair<string, Data::Keyword> &it : CHAIN)
+			if(data.Tag() == it.first)
+			{
+				++byString[it.second];
+				break;
+			}
+	});
+	vector<size_t> byKey(Data::KEYWORDS);
+	Time(path, "Look up Key()", [&byKey](const Data &data)
+	{
+		if(data.Key() != Data::OTHER)
+			++byKey[data.Key()];
+	});
+	
+	remove(path.c_str());
+	cout << (tokens / PASSES) << " tokens. Keyword counts "
+		<< (byString == byKey ? "match." : "DO NOT match.") << endl;
+	return (byString != byKey);
+}
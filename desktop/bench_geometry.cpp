@@ -0,0 +1,110 @@
+/* bench_geometry.cpp
+Copyright 2020 Michael Zahniser
+
+Benchmark for the polygon math that pathfinding relies on. Build it both with
+and without -DWIDE_GEOMETRY (see the makefile) to compare the cost of 64-bit
+intermediate values against plain ints, on a small room and on one that is too
+big for 32-bit cross products.
+*/
+
+#include "Point.h"
+#include "Polygon.h"
+#include "Ring.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Pathfinding works in coordinates scaled up by this amount.
+	const int INTERNAL_SCALE = 4;
+	// Number of obstacles along each side of the room.
+	const int GRID = 16;
+	// Number of sightline queries to run.
+	const int QUERIES = 20000;
+	
+	// Build an octagonal obstacle, counter-clockwise so it blocks movement.
+	Ring Obstacle(Point center, int radius)
+	{
+		Ring ring;
+		ring.emplace_back(center + Point(radius, radius / 3));
+		ring.emplace_back(center + Point(radius, -radius / 3));
+		ring.emplace_back(center + Point(radius / 3, -radius));
+		ring.emplace_back(center + Point(-radius / 3, -radius));
+		ring.emplace_back(center + Point(-radius, -radius / 3));
+		ring.emplace_back(center + Point(-radius, radius / 3));
+		ring.emplace_back(center + Point(-radius / 3, radius));
+		ring.emplace_back(center + Point(radius / 3, radius));
+		return ring;
+	}
+	
+	double Milliseconds(chrono::steady_clock::time_point start)
+	{
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		return elapsed.count();
+	}
+	
+	// Generate a room with the given side length (in pixels), using the same
+	// steps as Paths::Init(), then run sightline queries through it.
+	void Run(int size)
+	{
+		int spacing = size / GRID;
+		
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		Polygon passable;
+		Ring bounds;
+		bounds.emplace_back(0, 0);
+		bounds.emplace_back(size, 0);
+		bounds.emplace_back(size, size);
+		bounds.emplace_back(0, size);
+		passable.Add(bounds * INTERNAL_SCALE);
+		for(int y = 0; y < GRID; ++y)
+			for(int x = 0; x < GRID; ++x)
+			{
+				Point center(x * spacing + spacing / 2, y * spacing + spacing / 2);
+				passable.Add(Obstacle(center, spacing / 4) * INTERNAL_SCALE);
+			}
+		passable.FloodFill(Point(spacing / 8, spacing / 8) * INTERNAL_SCALE);
+		double buildTime = Milliseconds(start);
+		
+		// Use a fixed seed so both builds run exactly the same queries.
+		mt19937 random(1);
+		uniform_int_distribution<int> coordinate(0, size * INTERNAL_SCALE);
+		start = chrono::steady_clock::now();
+		int visible = 0;
+		for(int i = 0; i < QUERIES; ++i)
+		{
+			Point from(coordinate(random), coordinate(random));
+			Point to(coordinate(random), coordinate(random));
+			visible += !passable.Intersects(from, to) && passable.Contains((from + to) / 2);
+		}
+		double queryTime = Milliseconds(start);
+		
+		// Report the total area too, so it's easy to see if the math overflowed.
+		double area = 0.;
+		for(const Ring &ring : passable)
+			area += ring.Area();
+		
+		cout << "room " << size << "px: " << passable.size() << " rings, area "
+			<< static_cast<int64_t>(area / (INTERNAL_SCALE * INTERNAL_SCALE)) << ", "
+			<< visible << " visible" << endl;
+		cout << "  build: " << buildTime << " ms" << endl;
+		cout << "  queries: " << queryTime << " ms ("
+			<< (queryTime * 1000000. / QUERIES) << " ns each)" << endl;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	cout << "Geometry products: " << (sizeof(Point::Product) * 8) << "-bit" << endl;
+	Run(2000);
+	Run(40000);
+	
+	return 0;
+}
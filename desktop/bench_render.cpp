@@ -0,0 +1,221 @@
+/* bench_render.cpp
+Copyright 2020 Michael Zahniser
+
+Headless benchmark for drawing the game's frames. It loads a game's data with
+the dummy video driver, so no window is needed, then draws every room from a
+grid of avatar positions onto an offscreen surface. For each position it times
+Room::Draw() on its own, World::Draw() with the avatar in that room, and
+Dialog::Draw() on top of that, and prints a checksum of each of those frames so
+that changes to the rendering code can be checked for pixel-exact results. At
+the end it reports the frame rate and the number of blits and pixels drawn per
+frame for each of them.
+
+Usage: bench_render [path to data.txt]
+*/
+
+#include "Compositor.h"
+#include "Data.h"
+#include "Dialog.h"
+#include "Font.h"
+#include "Point.h"
+#include "Rect.h"
+#include "Room.h"
+#include "Sprite.h"
+#include "World.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Size of the offscreen "window" surface.
+	const int WIDTH = 1280;
+	const int HEIGHT = 720;
+	// Number of avatar positions to try across each room, in each direction.
+	const int SWEEP = 4;
+	// A mouse position that is not over any interaction icons.
+	const Point NO_HOVER(-100000, -100000);
+	const string TEXT = "say The quick brown fox jumps over the lazy dog. \"Whimsy\" isn't a real word, is it? "
+		"This line of dialog is long enough that it needs to be wrapped several times, so that the "
+		"dialog box is about as big as it would usually be in a game.";
+	
+	// Total time and work for one of the things that is drawn.
+	class Totals {
+	public:
+		// Time the given function, and count what it draws.
+		template <class Function>
+		void Time(Function draw)
+		{
+			Compositor::ResetCounts();
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			draw();
+			elapsed += chrono::steady_clock::now() - start;
+			++frames;
+			commands += Compositor::Commands();
+			pixels += Compositor::Pixels();
+		}
+		
+		void Print(const string &name) const
+		{
+			if(!frames)
+				return;
+			cout << name << ": " << (frames / elapsed.count()) << " fps, "
+				<< (commands / frames) << " blits and " << (pixels / frames) << " pixels per frame" << endl;
+		}
+		
+		chrono::duration<double> elapsed = chrono::duration<double>::zero();
+		uint64_t frames = 0;
+		uint64_t commands = 0;
+		uint64_t pixels = 0;
+	};
+	
+	uint32_t Checksum(SDL_Surface *screen)
+	{
+		uint32_t checksum = 0;
+		SDL_LockSurface(screen);
+		for(int y = 0; y < screen->h; ++y)
+		{
+			const uint8_t *row = reinterpret_cast<const uint8_t *>(screen->pixels) + y * screen->pitch;
+			for(int x = 0; x < screen->w * 4; ++x)
+				checksum = checksum * 31 + row[x];
+		}
+		SDL_UnlockSurface(screen);
+		return checksum;
+	}
+	
+	// Get the bounding box of everything in the given room.
+	Rect Bounds(const Room &room)
+	{
+		Rect bounds;
+		for(const Room::Entry &entry : room.Sprites())
+		{
+			Rect rect = entry.Bounds();
+			if(!bounds.w)
+				bounds = rect;
+			else
+				SDL_UnionRect(&bounds, &rect, &bounds);
+		}
+		return bounds;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	string path = (argc > 1 ? argv[1] : "../scenarios/woodlands/data.txt");
+	string directory = path.substr(0, path.rfind('/') + 1);
+	Font::SetDirectory(directory + "fonts/");
+	
+	// Use the dummy video driver, so this works without a display.
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", true);
+	if(SDL_Init(SDL_INIT_VIDEO))
+	{
+		cerr << "Unable to initialize SDL: " << SDL_GetError() << endl;
+		return 1;
+	}
+	IMG_Init(IMG_INIT_PNG);
+	
+	// Load the game the same way the engine does.
+	Data data(path);
+	if(World::LoadConfig(data).empty())
+	{
+		cerr << "Unable to load the game data." << endl;
+		return 1;
+	}
+	World::Load(data);
+	// Also keep a separate copy of each room, to draw them on their own.
+	map<string, Room> rooms;
+	for(Data file(path); file; file.Next())
+		if(file.Key() == Data::ROOM)
+			rooms[file.Value()].Load(file);
+	if(rooms.empty() || !Font::IsLoaded())
+	{
+		cerr << "Unable to load the rooms and fonts." << endl;
+		return 1;
+	}
+	
+	// Most window surfaces are 32-bit XRGB.
+	SDL_Surface *screen = SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, SDL_PIXELFORMAT_RGB888);
+	if(!screen)
+	{
+		cerr << "Unable to create the offscreen surface." << endl;
+		return 1;
+	}
+	Sprite::Prepare(screen->format);
+	Font::Prepare(screen->format);
+	Room::SetGroundCache(true);
+	
+	World world;
+	if(!world.New())
+	{
+		cerr << "Unable to start a new game." << endl;
+		return 1;
+	}
+	// The dialog box is drawn by its own Dialog object, so that its text does
+	// not depend on what happens in the world. The lines it shows must last
+	// as long as it does.
+	const vector<string> lines = {TEXT, "exit"};
+	Dialog dialog(world);
+	dialog.Begin(lines);
+	
+	Totals roomTotals;
+	Totals worldTotals;
+	Totals dialogTotals;
+	uint32_t combined = 0;
+	vector<Rect> damage;
+	for(const pair<const string, Room> &it : rooms)
+	{
+		const Room &room = it.second;
+		Rect bounds = Bounds(room);
+		for(int i = 0; i < SWEEP * SWEEP; ++i)
+		{
+			// Sweep the avatar across the middle of each grid cell.
+			Point position(
+				bounds.x + (bounds.w * (2 * (i % SWEEP) + 1)) / (2 * SWEEP),
+				bounds.y + (bounds.h * (2 * (i / SWEEP) + 1)) / (2 * SWEEP));
+			Point view = position - Point(WIDTH, HEIGHT) / 2;
+			
+			roomTotals.Time([&]() { room.Draw(screen, view, NO_HOVER, true); });
+			uint32_t roomSum = Checksum(screen);
+			
+			// Entering the room makes the world repaint the entire screen.
+			world.Enter(position, it.first);
+			worldTotals.Time([&]() { world.Draw(screen, NO_HOVER, damage); });
+			uint32_t worldSum = Checksum(screen);
+			
+			dialogTotals.Time([&]() { dialog.Draw(screen, NO_HOVER); });
+			uint32_t dialogSum = Checksum(screen);
+			
+			char line[200];
+			snprintf(line, sizeof(line), "%s %d,%d: room %08x, world %08x, dialog %08x",
+				it.first.c_str(), position.X(), position.Y(), roomSum, worldSum, dialogSum);
+			cout << line << endl;
+			combined = ((combined * 31 + roomSum) * 31 + worldSum) * 31 + dialogSum;
+		}
+	}
+	
+	roomTotals.Print("Room::Draw");
+	worldTotals.Print("World::Draw");
+	dialogTotals.Print("Dialog::Draw");
+	char line[40];
+	snprintf(line, sizeof(line), "Combined checksum: %08x", combined);
+	cout << line << endl;
+	
+	SDL_FreeSurface(screen);
+	Sprite::FreeAll();
+	Font::FreeAll();
+	IMG_Quit();
+	SDL_Quit();
+	return 0;
+}
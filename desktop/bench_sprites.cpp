@@ -0,0 +1,116 @@
+/* bench_sprites.cpp
+Copyright 2020 Michael Zahniser
+
+Headless benchmark for sprite drawing. It loads the sprites from a game data
+file, then draws all of them onto an offscreen surface in the usual window
+format, first straight from the loaded sprite sheets and then after
+Sprite::Prepare() has converted them. No window or display is needed.
+
+Usage: bench_sprites [path to data.txt]
+*/
+
+#include "Data.h"
+#include "Point.h"
+#include "Sprite.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+	// Size of the offscreen "window" surface.
+	const int WIDTH = 1920;
+	const int HEIGHT = 1080;
+	// Number of times to draw every sprite.
+	const int PASSES = 20;
+	// Highest sprite index to look for.
+	const int MAX_SPRITE = 10000;
+	
+	// Draw every sprite PASSES times, spread out over the surface, and report
+	// how long it took. Return a checksum of the final image.
+	uint32_t Run(const string &label, SDL_Surface *screen)
+	{
+		int64_t blits = 0;
+		int64_t pixels = 0;
+		uint32_t checksum = 0;
+		chrono::duration<double> elapsed(0.);
+		for(int pass = 0; pass < PASSES; ++pass)
+		{
+			// Only time the drawing, not clearing the screen or the checksum.
+			SDL_FillRect(screen, nullptr, SDL_MapRGB(screen->format, 64, 64, 64));
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for(int i = 1; i < MAX_SPRITE; ++i)
+			{
+				const Sprite &sprite = Sprite::Get(i);
+				if(!sprite.Width())
+					continue;
+				
+				Point center((i * 97) % WIDTH, (i * 61) % HEIGHT);
+				sprite.Draw(screen, center);
+				++blits;
+				pixels += sprite.Width() * sprite.Height();
+			}
+			elapsed += chrono::steady_clock::now() - start;
+		}
+		
+		SDL_LockSurface(screen);
+		for(int y = 0; y < screen->h; ++y)
+		{
+			const uint8_t *row = reinterpret_cast<const uint8_t *>(screen->pixels) + y * screen->pitch;
+			for(int x = 0; x < screen->w * 4; ++x)
+				checksum = checksum * 31 + row[x];
+		}
+		SDL_UnlockSurface(screen);
+		
+		double seconds = elapsed.count();
+		cout << label << ": " << blits << " blits in " << (seconds * 1000.) << " ms ("
+			<< (blits / seconds) << " blits/s, " << (pixels / seconds / 1000000.) << " Mpixels/s)" << endl;
+		return checksum;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	string path = (argc > 1 ? argv[1] : "../scenarios/woodlands/data.txt");
+	
+	SDL_Init(0);
+	IMG_Init(IMG_INIT_PNG);
+	
+	// Load only the sprite definitions from the data file.
+	for(Data data(path); data; data.Next())
+	{
+		if(data.Key() == Data::INDEX)
+			Sprite::SetIndex(data);
+		else if(data.Key() == Data::SHEET)
+			Sprite::LoadSheet(data);
+		else if(data.Key() == Data::SPRITE)
+			Sprite::Add(data);
+	}
+	
+	// Most window surfaces are 32-bit XRGB.
+	SDL_Surface *screen = SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, SDL_PIXELFORMAT_RGB888);
+	if(!screen)
+	{
+		cerr << "Unable to create the offscreen surface." << endl;
+		return 1;
+	}
+	
+	uint32_t before = Run("loaded sheets", screen);
+	Sprite::Prepare(screen->format);
+	uint32_t after = Run("prepared sheets", screen);
+	cout << "output " << (before == after ? "is identical" : "differs") << endl;
+	
+	SDL_FreeSurface(screen);
+	Sprite::FreeAll();
+	IMG_Quit();
+	SDL_Quit();
+	return 0;
+}
@@ -0,0 +1,150 @@
+/* bench_startup.cpp
+Copyright 2020 Michael Zahniser
+
+Benchmark for starting up a game. It loads a game the way the engine does,
+with the dummy video driver so no window is needed, both from its data files
+and images and from the bundle that "pack" makes of them. Each load is timed
+from opening the data until the sprites and fonts are ready to draw, and each
+is done in a new process, so that nothing is left over from the one before.
+Cold loads first drop all the game's files from the operating system's cache,
+as if the game had not been run since the computer was started; warm loads
+find them already in memory.
+
+Usage: bench_startup [path to data.txt]
+The game must have been packed first, and the bundle must be up to date.
+*/
+
+#include "Bundle.h"
+#include "Data.h"
+#include "Font.h"
+#include "Sprite.h"
+#include "World.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+	// Number of times to load the game each way.
+	const int PASSES = 5;
+	
+	// Drop the given files from the operating system's cache.
+	void Evict(const vector<string> &files)
+	{
+		for(const string &path : files)
+		{
+			int fd = open(path.c_str(), O_RDONLY);
+			if(fd < 0)
+				continue;
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+	}
+	
+	// Load the game, and return how long that took in milliseconds, or a
+	// negative number if it failed.
+	double Load(const string &path, bool useBundle)
+	{
+		string directory = path.substr(0, path.rfind('/') + 1);
+		Font::SetDirectory(directory + "fonts/");
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", true);
+		if(SDL_Init(SDL_INIT_VIDEO))
+			return -1.;
+		IMG_Init(IMG_INIT_PNG);
+		SDL_Surface *screen = SDL_CreateRGBSurfaceWithFormat(0, 1280, 720, 32, SDL_PIXELFORMAT_RGB888);
+		if(!screen)
+			return -1.;
+		
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		if(useBundle && !Bundle::Open(path))
+			return -1.;
+		Data data(path);
+		if(World::LoadConfig(data).empty())
+			return -1.;
+		World::Load(data);
+		Sprite::Prepare(screen->format);
+		Font::Prepare(screen->format);
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		
+		return Font::IsLoaded() ? elapsed.count() : -1.;
+	}
+	
+	// Load the game in a new process, and return how long it took.
+	double Time(const string &path, bool useBundle)
+	{
+		int result[2];
+		if(pipe(result))
+			return -1.;
+		
+		pid_t child = fork();
+		if(!child)
+		{
+			// Exit without flushing any output inherited from the parent, and
+			// without bothering to free everything that was loaded.
+			double elapsed = Load(path, useBundle);
+			ssize_t written = write(result[1], &elapsed, sizeof(elapsed));
+			_exit(written != sizeof(elapsed));
+		}
+		close(result[1]);
+		double elapsed = -1.;
+		if(child < 0 || read(result[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+			elapsed = -1.;
+		close(result[0]);
+		if(child > 0)
+			waitpid(child, nullptr, 0);
+		return elapsed;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	string path = (argc > 1 ? argv[1] : "../scenarios/woodlands/data.txt");
+	
+	// Find out what files the game loads from, so they can be evicted.
+	if(!Bundle::Open(path))
+	{
+		cerr << "No up to date bundle for " << path << ". Run pack first." << endl;
+		return 1;
+	}
+	vector<string> files = Bundle::Files();
+	files.push_back(Bundle::Path(path));
+	Bundle::Close();
+	cout << files.size() - 1 << " files in " << Bundle::Path(path) << "." << endl;
+	
+	for(bool isCold : {true, false})
+		for(bool useBundle : {false, true})
+		{
+			vector<double> times;
+			for(int pass = 0; pass < PASSES; ++pass)
+			{
+				if(isCold)
+					Evict(files);
+				cout.flush();
+				double elapsed = Time(path, useBundle);
+				if(elapsed < 0.)
+				{
+					cerr << "Unable to load the game from " << (useBundle ? "the bundle." : "the data files.") << endl;
+					return 1;
+				}
+				times.push_back(elapsed);
+			}
+			sort(times.begin(), times.end());
+			cout << (isCold ? "Cold" : "Warm") << " start from " << (useBundle ? "bundle" : "data files")
+				<< ": " << times[times.size() / 2] << " ms median, " << times.front() << " ms best" << endl;
+		}
+	return 0;
+}
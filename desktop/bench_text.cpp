@@ -0,0 +1,178 @@
+/* bench_text.cpp
+Copyright 2020 Michael Zahniser
+
+Benchmark for wrapping text. It loads the fonts from a game data file and every
+line of dialog from the dialog.txt file next to it, then repeatedly wraps each
+of those lines, and all of them joined into one long paragraph, at several
+different widths. For each width it reports how long a wrap takes and the total
+height of the wrapped text. It also reports how much memory the glyph sheets
+use.
+
+The layout of every wrapped line is also checked against a file of expected
+layouts, because it should not change when the wrapping code is optimized. The
+file has one line for each wrapped line of text, with its y position, how many
+glyphs it has, the x positions of its first and last glyph, and a hash of the
+font, index, and position of each of its glyphs. If the file does not exist
+yet, it is written instead.
+
+Usage: bench_text [path to data.txt] [path to expected layouts]
+Without any arguments, this checks the Woodlands dialog against bench_text.txt.
+Returns 0 if the layouts matched or were written.
+*/
+
+#include "Data.h"
+#include "Font.h"
+#include "Text.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Number of times to wrap each piece of text, at each width.
+	const int PASSES = 200;
+	
+	// Number each font in the order it is first used, so the layouts do not
+	// depend on where the fonts are in memory.
+	map<const Font *, int> fontNumbers;
+	
+	// Describe the layout of each line of the given wrapped text.
+	void Describe(const Text &text, ostream &out)
+	{
+		const vector<Font::Glyph> &glyphs = text.Glyphs();
+		for(auto first = glyphs.begin(); first != glyphs.end(); )
+		{
+			auto last = first;
+			uint32_t hash = 2166136261u;
+			for( ; last != glyphs.end() && last->point.Y() == first->point.Y(); ++last)
+			{
+				int font = fontNumbers.emplace(last->font, fontNumbers.size()).first->second;
+				for(int value : {font, last->index, static_cast<int>(last->point.X())})
+					hash = (hash ^ static_cast<uint32_t>(value)) * 16777619u;
+			}
+			out << first->point.Y() << ' ' << (last - first) << ' ' << first->point.X()
+				<< ' ' << (last - 1)->point.X() << ' ' << hex << hash << dec << '\n';
+			first = last;
+		}
+	}
+	
+	// Time wrapping each of the given pieces of text at the given width, and
+	// describe how each one was laid out.
+	void Time(const vector<string> &texts, int width, const string &name, ostream &layout)
+	{
+		Text text(width);
+		int height = 0;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for(int pass = 0; pass < PASSES; ++pass)
+			for(const string &it : texts)
+			{
+				text.Wrap(it);
+				height += text.Height();
+			}
+		chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+		
+		cout << name << " at width " << width << ": " << (elapsed.count() / (PASSES * texts.size()))
+			<< " us per wrap, total height " << (height / PASSES) << endl;
+		
+		for(size_t i = 0; i < texts.size(); ++i)
+		{
+			text.Wrap(texts[i]);
+			layout << name << " at width " << width << ", text " << (i + 1) << '\n';
+			Describe(text, layout);
+		}
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	string path = (argc > 1 ? argv[1] : "../scenarios/woodlands/data.txt");
+	string layoutPath = (argc > 2 ? argv[2] : argc > 1 ? "" : "bench_text.txt");
+	string directory = path.substr(0, path.rfind('/') + 1);
+	Font::SetDirectory(directory + "fonts/");
+	
+	SDL_Init(0);
+	IMG_Init(IMG_INIT_PNG);
+	
+	for(Data data(path); data; data.Next())
+		if(data.Key() == Data::STYLE)
+			Font::Add(data);
+	
+	// Collect every line of dialog, and also join them all together into one
+	// long paragraph.
+	vector<string> lines;
+	string paragraph;
+	ifstream in(directory + "dialog.txt");
+	for(string line; getline(in, line); )
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if(start == string::npos || line.compare(start, 4, "say "))
+			continue;
+		
+		lines.push_back(line.substr(start + 4));
+		paragraph += (paragraph.empty() ? "" : " ") + lines.back();
+	}
+	if(lines.empty() || !Font::IsLoaded())
+	{
+		cerr << "Unable to load the fonts and dialog." << endl;
+		return 1;
+	}
+	cout << lines.size() << " lines of dialog, " << paragraph.size() << " characters in all." << endl;
+	cout << "Glyph sheets use " << (Font::Memory() >> 10) << " kB." << endl;
+	
+	ostringstream layout;
+	for(int width : {200, 400, 800})
+	{
+		Time(lines, width, "Each line", layout);
+		Time({paragraph}, width, "One paragraph", layout);
+	}
+	
+	Font::FreeAll();
+	IMG_Quit();
+	SDL_Quit();
+	if(layoutPath.empty())
+		return 0;
+	
+	// Check the layouts against the expected ones, or save them if there are
+	// none yet.
+	ifstream expectedIn(layoutPath);
+	if(!expectedIn)
+	{
+		ofstream out(layoutPath);
+		out << layout.str();
+		cout << "Wrote the layouts to " << layoutPath << "." << endl;
+		return !out;
+	}
+	string expected{istreambuf_iterator<char>(expectedIn), istreambuf_iterator<char>()};
+	if(expected == layout.str())
+	{
+		cout << "The layouts match " << layoutPath << "." << endl;
+		return 0;
+	}
+	
+	// Report the first line that is different, and which text it is in.
+	istringstream expectedLines(expected);
+	istringstream actualLines(layout.str());
+	string heading;
+	string expectedLine;
+	string actualLine;
+	while(getline(expectedLines, expectedLine) && getline(actualLines, actualLine) && expectedLine == actualLine)
+		if(!isdigit(static_cast<unsigned char>(actualLine[0])))
+			heading = actualLine;
+	cerr << "The layouts DO NOT match " << layoutPath << ". In " << heading << ":" << endl
+		<< "Expected: " << expectedLine << endl << "Got:      " << actualLine << endl;
+	return 1;
+}
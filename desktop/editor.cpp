@@ -132,7 +132,7 @@ int main(int argc, char *argv[])
 	// Load the interaction prototypes.
 	for(Data data(directory + "interactions.txt"); data; data.Next())
 	{
-		if(data.Tag() == "interaction")
+		if(data.Key() == Data::INTERACTION)
 		{
 			interactions.emplace_back(data);
 			interactions.back().SetState(Interaction::ACTIVE);
@@ -334,12 +334,11 @@ void DrawSprites()
 	// Fill the background with the default grass color.
 	SDL_FillRect(screen, nullptr, background(screen));
 	
-	int index = 0;
+	// Show the selected sprite where it would be placed.
+	vector<Room::Entry> preview;
 	if(selected && isHovering)
-		index = room.Add(selected, hover);
-	room.Draw(screen, scroll, hover, false);
-	if(selected && isHovering)
-		room.Remove(index);
+		preview.emplace_back(selected, hover, "");
+	room.Draw(screen, scroll, hover, false, preview);
 	
 	if(interaction && isHovering)
 	{
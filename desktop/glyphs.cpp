@@ -1,12 +1,22 @@
 /* glyphs.cpp
 Copyright 2020 Michael Zahniser
 
-Program to export glyphs for a bitmap font.
+Program to export glyphs for a bitmap font. With no arguments, it exports the
+main glyph sheet, with ASCII characters and curly quotes, to font.bmp. Any
+arguments are the numbers of other pages of 256 Unicode code points, in hex,
+and each of those is exported to font-u<page>.bmp instead. The game loads each
+page the first time one of its characters is used, if the file exists, so only
+the pages a game's text needs should be exported.
+
+Usage: glyphs [page ...]
 */
 
+#include <cstdio>
+#include <cstdlib>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <string>
 
 #include <freetype2/ft2build.h>
 #include FT_FREETYPE_H
@@ -14,6 +24,7 @@ Program to export glyphs for a bitmap font.
 using namespace std;
 
 static const int GLYPHS = 98;
+static const int PAGE_SIZE = 256;
 
 static const int FONT_SIZE = 16;
 static const int CHAR_W = 18;
@@ -22,12 +33,13 @@ static const int BASE = 13;
 static const int LEFT = 2;
 static const int DPI = 72;
 
-static const int WIDTH = CHAR_W * GLYPHS;
 static const int HEIGHT = CHAR_H;
 static const int GLYPH_PITCH = CHAR_W;
 
 static const char *filename = "/usr/local/share/fonts/truetype/Optima.ttf";
 
+static void Export(FT_Face face, const vector<int> &codes, const string &path);
+
 
 
 int main(int argc, char *argv[])
@@ -39,23 +51,55 @@ int main(int argc, char *argv[])
 	FT_New_Face(library, filename, 0, &face);
 	
 	FT_Set_Char_Size(face, FONT_SIZE * 64, 0, DPI, 0);
+	
+	if(argc < 2)
+	{
+		vector<int> codes;
+		for(int n = 32; n < 32 + GLYPHS; ++n)
+		{
+			// Map normal quotes to curly quotes.
+			int trueN = n;
+			if(n == '\'')
+				trueN = 0x2019;
+			if(n == '"')
+				trueN = 0x201D;
+			if(n == 128)
+				trueN = 0x2018;
+			if(n == 129)
+				trueN = 0x201C;
+			codes.push_back(trueN);
+		}
+		Export(face, codes, "font.bmp");
+	}
+	for(int i = 1; i < argc; ++i)
+	{
+		int page = strtol(argv[i], nullptr, 16);
+		vector<int> codes;
+		for(int n = 0; n < PAGE_SIZE; ++n)
+			codes.push_back(page * PAGE_SIZE + n);
+		
+		char path[32];
+		snprintf(path, sizeof(path), "font-u%02x.bmp", page);
+		Export(face, codes, path);
+	}
+	
+	return 0;
+}
+
+
+
+// Draw the given characters into a row of glyphs, and save it as a bitmap.
+static void Export(FT_Face face, const vector<int> &codes, const string &path)
+{
+	const int WIDTH = CHAR_W * codes.size();
 	FT_GlyphSlot slot = face->glyph;
 	
 	vector<unsigned char> image(WIDTH * HEIGHT, 0);
 	vector<unsigned char>::iterator start = image.begin();
-	for(int n = 32; n < 32 + GLYPHS; ++n)
+	for(int code : codes)
 	{
-		// Map normal quotes to curly quotes.
-		int trueN = n;
-		if(n == '\'')
-			trueN = 0x2019;
-		if(n == '"')
-			trueN = 0x201D;
-		if(n == 128)
-			trueN = 0x2018;
-		if(n == 129)
-			trueN = 0x201C;
-		FT_Load_Char(face, trueN, FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT);
+		// Characters that are not in the font are drawn as its "missing" glyph.
+		FT_Load_Char(face, code, FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT);
 		
 		// Copy the glyph into the output bitmap.
 		for(size_t row = 0; row < slot->bitmap.rows; ++row)
@@ -71,7 +115,7 @@ int main(int argc, char *argv[])
 		start += GLYPH_PITCH;
 	}
 	
-	ofstream out("font.bmp", ios::out | ios::binary);
+	ofstream out(path, ios::out | ios::binary);
 	out.put('B');
 	out.put('M');
 	
@@ -115,6 +159,4 @@ int main(int argc, char *argv[])
 		out.put(*it);
 		out.put(255);
 	}
-	
-	return 0;
 }
@@ -168,24 +168,24 @@ void Load(string path)
 	
 	for(Data data(path + ".txt"); data; data.Next())
 	{
-		if(data.Tag() == "sprite")
+		if(data.Key() == Data::SPRITE)
 		{
 			sprites.emplace_back();
 			Sprite &sprite = sprites.back();
 			
 			while(data.Next() && data.Size())
 			{
-				if(data.Tag() == "bounds" && data.Size() == 3)
+				if(data.Key() == Data::BOUNDS && data.Size() == 3)
 				{
 					Point a = data[1];
 					Point b = data[2];
 					sprite.bounds = Rect(a, b);
 				}
-				else if(data.Tag() == "baseline" && data.Size() == 2)
+				else if(data.Key() == Data::BASELINE && data.Size() == 2)
 					sprite.baseline = data[1];
-				else if(data.Tag() == "layer" && data.Size() == 2)
+				else if(data.Key() == Data::LAYER && data.Size() == 2)
 					sprite.layer = data[1];
-				else if(data.Tag() == "mask")
+				else if(data.Key() == Data::MASK)
 				{
 					sprite.mask.emplace_back();
 					vector<Point> &part = sprite.mask.back();
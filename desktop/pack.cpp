@@ -0,0 +1,117 @@
+/* pack
+Copyright 2020 Michael Zahniser
+
+Program to pack a game's data files, its decoded sprite sheets and glyph
+sheets, and its font kerning into a single bundle file beside the data file.
+If the bundle is there, the engine loads everything from it instead, which is
+much faster than reading each file and decoding each image. The bundle must be
+packed again after the data changes; the engine will not use it until then.
+*/
+
+#include "Bundle.h"
+#include "Data.h"
+#include "Font.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+
+
+// Add the given data file, and every file that it includes, the same way
+// that a Data object would find them.
+bool AddText(Bundle::Builder &builder, const string &path)
+{
+	if(builder.Has(path))
+		return true;
+	if(!builder.AddFile(path))
+	{
+		cerr << "Unable to read " << path << endl;
+		return false;
+	}
+	
+	string directory = path.substr(0, path.rfind('/') + 1);
+	ifstream in(path);
+	bool success = true;
+	for(string line; getline(in, line); )
+	{
+		static const string INCLUDE = "include";
+		size_t i = line.find_first_not_of(" \t\r");
+		if(i == string::npos || line.compare(i, INCLUDE.size(), INCLUDE)
+				|| line.size() <= i + INCLUDE.size() || !isspace(static_cast<unsigned char>(line[i + INCLUDE.size()])))
+			continue;
+		
+		i = line.find_first_not_of(" \t\r", i + INCLUDE.size());
+		if(i != string::npos)
+			success &= AddText(builder, directory + line.substr(i));
+	}
+	return success;
+}
+
+
+
+// Add each image or other file, unless it has already been added.
+bool Add(Bundle::Builder &builder, const string &path)
+{
+	if(builder.Has(path))
+		return true;
+	
+	bool isImage = (path.size() > 4 && !path.compare(path.size() - 4, 4, ".png"));
+	if(isImage ? builder.AddImage(path) : builder.AddFile(path))
+		return true;
+	
+	cerr << "Unable to load " << path << endl;
+	return false;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	if(argc != 2)
+	{
+		cerr << "Usage: $ ./pack <data file>" << endl;
+		return 1;
+	}
+	string path = argv[1];
+	string directory = path.substr(0, path.rfind('/') + 1);
+	Font::SetDirectory(directory + "fonts/");
+	
+	SDL_Init(0);
+	IMG_Init(IMG_INIT_PNG);
+	
+	// Add the text of every data file.
+	Bundle::Builder builder;
+	bool success = AddText(builder, path);
+	
+	// Add every sprite sheet. Loading each font also writes out its cached
+	// kerning, if it was not there already.
+	for(Data data(path); data; data.Next())
+	{
+		if(data.Key() == Data::SHEET)
+			success &= Add(builder, data.Directory() + data.Value());
+		else if(data.Key() == Data::STYLE)
+			Font::Add(data);
+	}
+	for(const string &file : Font::Files())
+		success &= Add(builder, file);
+	
+	if(!builder.Write(path))
+	{
+		cerr << "Unable to write " << Bundle::Path(path) << endl;
+		success = false;
+	}
+	else
+		cout << "Packed " << builder.Size() << " files into " << Bundle::Path(path) << endl;
+	
+	Font::FreeAll();
+	IMG_Quit();
+	SDL_Quit();
+	return !success;
+}
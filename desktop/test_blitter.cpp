@@ -0,0 +1,184 @@
+/* test_blitter.cpp
+Copyright 2020 Michael Zahniser
+
+Check that the Blitter draws exactly the same pixels as SDL_BlitSurface(). A
+random test image, with rows of transparent, opaque, and partly transparent
+runs and one ramp through every alpha value, is drawn at random positions onto
+random backgrounds with random clipping rectangles, both by SDL and by each
+blending kernel that this CPU supports. Drawing the image in a single color is
+checked against SDL drawing a copy of it with that color filled in. It also
+reports how fast each of them draws the test image. No window or display is
+needed.
+
+Usage: test_blitter
+Returns 0 if every test matched.
+*/
+
+#include "Blitter.h"
+#include "Point.h"
+#include "Rect.h"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+	// Size of the test image and the surface it is drawn onto.
+	const int IMAGE_WIDTH = 300;
+	const int IMAGE_HEIGHT = 80;
+	const int WIDTH = 640;
+	const int HEIGHT = 400;
+	// Number of random placements to test for each kernel and format.
+	const int TRIALS = 200;
+	// Number of times to draw the image when timing.
+	const int PASSES = 20000;
+	
+	uint32_t *Row(SDL_Surface *surface, int y)
+	{
+		uint8_t *bytes = reinterpret_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+		return reinterpret_cast<uint32_t *>(bytes);
+	}
+	
+	// Fill the given surface with random runs of pixels. The first rows get a
+	// ramp through every possible alpha value instead.
+	void Randomize(SDL_Surface *surface, bool hasRuns)
+	{
+		for(int y = 0; y < surface->h; ++y)
+		{
+			uint32_t *row = Row(surface, y);
+			for(int x = 0; x < surface->w; )
+			{
+				int length = 1 + rand() % 40;
+				int kind = rand() % 3;
+				for(int end = min(surface->w, x + length); x < end; ++x)
+				{
+					uint32_t alpha = rand() & 0xFF;
+					if(hasRuns && y < 16)
+						alpha = x & 0xFF;
+					else if(hasRuns && kind < 2)
+						alpha = kind * 255;
+					row[x] = (alpha << 24) | (rand() & 0xFFFF) | ((rand() & 0xFF) << 16);
+				}
+			}
+		}
+	}
+	
+	bool Same(SDL_Surface *a, SDL_Surface *b)
+	{
+		for(int y = 0; y < a->h; ++y)
+			if(memcmp(Row(a, y), Row(b, y), a->w * sizeof(uint32_t)))
+				return false;
+		return true;
+	}
+	
+	// Run all the tests for one combination of image and target formats.
+	bool Test(uint32_t imageFormat, uint32_t targetFormat, const char *name)
+	{
+		SDL_Surface *image = SDL_CreateRGBSurfaceWithFormat(0, IMAGE_WIDTH, IMAGE_HEIGHT, 32, imageFormat);
+		SDL_Surface *tinted = SDL_CreateRGBSurfaceWithFormat(0, IMAGE_WIDTH, IMAGE_HEIGHT, 32, imageFormat);
+		SDL_Surface *expected = SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, targetFormat);
+		SDL_Surface *actual = SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, targetFormat);
+		if(!image || !tinted || !expected || !actual || !Blitter::IsSupported(image->format, actual->format))
+		{
+			cerr << name << ": unable to create the test surfaces." << endl;
+			return false;
+		}
+		SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_BLEND);
+		Randomize(image, true);
+		Rect from(7, 3, IMAGE_WIDTH - 20, IMAGE_HEIGHT - 6);
+		Blitter mask(image, from);
+		
+		// Make a copy of the image with every pixel's color replaced.
+		uint32_t alpha = image->format->Amask;
+		uint32_t color = SDL_MapRGB(image->format, 40, 200, 120) & ~alpha;
+		SDL_SetSurfaceBlendMode(tinted, SDL_BLENDMODE_BLEND);
+		for(int y = 0; y < IMAGE_HEIGHT; ++y)
+			for(int x = 0; x < IMAGE_WIDTH; ++x)
+				Row(tinted, y)[x] = (Row(image, y)[x] & alpha) | color;
+		
+		bool passed = true;
+		for(int i = Blitter::SCALAR; i <= Blitter::AVX2; ++i)
+		{
+			Blitter::Kernel kernel = static_cast<Blitter::Kernel>(i);
+			if(!Blitter::SetKernel(kernel))
+				continue;
+			
+			int failures = 0;
+			for(int trial = 0; trial < TRIALS; ++trial)
+			{
+				// Include placements that are partly off the edges of the
+				// clipping rectangle.
+				Randomize(expected, false);
+				for(int y = 0; y < HEIGHT; ++y)
+					memcpy(Row(actual, y), Row(expected, y), WIDTH * sizeof(uint32_t));
+				SDL_Rect clip = {rand() % 100, rand() % 100, 100 + rand() % WIDTH, 100 + rand() % HEIGHT};
+				SDL_SetClipRect(expected, &clip);
+				SDL_SetClipRect(actual, &clip);
+				Point corner(rand() % WIDTH - from.w / 2, rand() % HEIGHT - from.h / 2);
+				
+				// SDL_BlitSurface() changes the rectangle it is given.
+				SDL_Rect to = {corner.X(), corner.Y(), 0, 0};
+				SDL_BlitSurface(image, &from, expected, &to);
+				mask.Draw(image, from, actual, corner);
+				failures += !Same(expected, actual);
+				
+				// Then draw the image again, in a single color.
+				to = {corner.X(), corner.Y(), 0, 0};
+				SDL_BlitSurface(tinted, &from, expected, &to);
+				mask.Draw(image, from, actual, corner, color);
+				failures += !Same(expected, actual);
+				SDL_SetClipRect(expected, nullptr);
+				SDL_SetClipRect(actual, nullptr);
+			}
+			
+			// Time drawing the image entirely inside the target.
+			SDL_Rect to = {100, 100, 0, 0};
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for(int pass = 0; pass < PASSES; ++pass)
+			{
+				SDL_Rect rect = to;
+				SDL_BlitSurface(image, &from, expected, &rect);
+			}
+			chrono::duration<double, milli> sdl = chrono::steady_clock::now() - start;
+			start = chrono::steady_clock::now();
+			for(int pass = 0; pass < PASSES; ++pass)
+				mask.Draw(image, from, actual, Point(to.x, to.y));
+			chrono::duration<double, milli> fast = chrono::steady_clock::now() - start;
+			
+			cout << name << ", " << Blitter::KernelName(kernel) << ": "
+				<< (failures ? to_string(failures) + " of " + to_string(2 * TRIALS) + " tests differ" : string("identical"))
+				<< " (SDL " << sdl.count() << " ms, Blitter " << fast.count() << " ms for "
+				<< PASSES << " draws)" << endl;
+			passed &= !failures;
+		}
+		
+		SDL_FreeSurface(image);
+		SDL_FreeSurface(tinted);
+		SDL_FreeSurface(expected);
+		SDL_FreeSurface(actual);
+		return passed;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	SDL_Init(0);
+	
+	// Test the two common window formats, and a target with an alpha channel.
+	bool passed = Test(SDL_PIXELFORMAT_ARGB8888, SDL_PIXELFORMAT_RGB888, "ARGB onto XRGB");
+	passed &= Test(SDL_PIXELFORMAT_ABGR8888, SDL_PIXELFORMAT_BGR888, "ABGR onto XBGR");
+	passed &= Test(SDL_PIXELFORMAT_ARGB8888, SDL_PIXELFORMAT_ARGB8888, "ARGB onto ARGB");
+	
+	SDL_Quit();
+	cout << (passed ? "All tests passed." : "Some tests FAILED.") << endl;
+	return !passed;
+}
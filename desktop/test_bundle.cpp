@@ -0,0 +1,103 @@
+/* test_bundle.cpp
+Copyright 2020 Michael Zahniser
+
+Check that a game's bundle holds exactly what is in the files it was packed
+from. Each text file must have the same contents, and each image must have the
+same size and pixels as the image file converted to the same format. The pixels
+of each image must also start on a 64-byte boundary, and must be used directly
+from the bundle instead of being copied.
+
+Usage: test_bundle [path to data.txt]
+The game must have been packed first, and the bundle must be up to date.
+Returns 0 if every file matched.
+*/
+
+#include "Bundle.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using namespace std;
+
+namespace {
+	// Check that the given text file is the same in the bundle as on disk.
+	bool CheckFile(const string &path)
+	{
+		ifstream in(path, ios::binary);
+		string contents{istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+		string_view packed = Bundle::Find(path);
+		if(!packed.data() || packed != contents)
+		{
+			cerr << path << ": contents do not match." << endl;
+			return false;
+		}
+		return true;
+	}
+	
+	// Check that the given image is the same in the bundle as on disk.
+	bool CheckImage(const string &path)
+	{
+		SDL_Surface *packed = Bundle::LoadImage(path);
+		SDL_Surface *image = IMG_Load(path.c_str());
+		SDL_Surface *converted = (packed && image ? SDL_ConvertSurfaceFormat(image, packed->format->format, 0) : nullptr);
+		
+		bool success = false;
+		if(!converted)
+			cerr << path << ": unable to load." << endl;
+		else if(!(packed->flags & SDL_PREALLOC))
+			cerr << path << ": pixels were not loaded from the bundle." << endl;
+		else if(reinterpret_cast<uintptr_t>(packed->pixels) % 64)
+			cerr << path << ": pixels are not aligned to 64 bytes." << endl;
+		else if(packed->w != converted->w || packed->h != converted->h)
+			cerr << path << ": size does not match." << endl;
+		else
+		{
+			success = true;
+			for(int y = 0; success && y < packed->h; ++y)
+				success = !memcmp(static_cast<const char *>(packed->pixels) + y * packed->pitch,
+					static_cast<const char *>(converted->pixels) + y * converted->pitch, packed->w * 4);
+			if(!success)
+				cerr << path << ": pixels do not match." << endl;
+		}
+		
+		SDL_FreeSurface(converted);
+		SDL_FreeSurface(image);
+		SDL_FreeSurface(packed);
+		return success;
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	string path = (argc > 1 ? argv[1] : "../scenarios/woodlands/data.txt");
+	SDL_Init(0);
+	IMG_Init(IMG_INIT_PNG);
+	
+	if(!Bundle::Open(path))
+	{
+		cerr << "No up to date bundle for " << path << ". Run pack first." << endl;
+		return 1;
+	}
+	int failures = 0;
+	vector<string> files = Bundle::Files();
+	for(const string &file : files)
+	{
+		bool isImage = (file.size() > 4 && !file.compare(file.size() - 4, 4, ".png"));
+		failures += !(isImage ? CheckImage(file) : CheckFile(file));
+	}
+	Bundle::Close();
+	
+	cout << (files.size() - failures) << " of " << files.size() << " files matched." << endl;
+	IMG_Quit();
+	SDL_Quit();
+	return (failures != 0);
+}
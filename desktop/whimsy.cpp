@@ -4,19 +4,31 @@ Copyright 2020 Michael Zahniser
 C++ engine for "Whimsy" games.
 */
 
+#include "Bundle.h"
+#include "Clock.h"
+#include "Compositor.h"
 #include "Data.h"
 #include "Font.h"
 #include "Menu.h"
 #include "Point.h"
+#include "Rect.h"
+#include "Room.h"
 #include "Sprite.h"
+#include "Stats.h"
+#include "Trace.h"
 #include "World.h"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -30,9 +42,23 @@ namespace {
 	string preferencesPath;
 	Point windowSize = MIN_WINDOW_SIZE;
 	bool fullscreen = false;
+	// Number of threads for the compositor to use, or 0 to draw directly.
+	int compositorThreads = 0;
+	// Memory for caching rendered text, in kilobytes.
+	const int DEFAULT_TEXT_CACHE = 4096;
+	int textCache = DEFAULT_TEXT_CACHE;
+	// Format of the frame statistics log ("csv" or "json"), if it is enabled.
+	// It is only written by builds with WHIMSY_STATS defined.
+	string statsLog;
 	
-	// Frame rate control.
+	// Frame rate control. The timer only runs while something on screen may
+	// change from one frame to the next. It fires once per display refresh,
+	// while the simulation and the sprite animations each have their own
+	// fixed rate.
 	SDL_TimerID frameTimer = 0;
+	int refreshRate = 60;
+	Clock simulation;
+	Clock animation;
 	
 	// The two main UI layers: the menu, and the world view (which includes a
 	// dialog overlay).
@@ -42,6 +68,9 @@ namespace {
 
 // Handle events, and return true unless it's time to quit.
 bool HandleEvents();
+void UpdateTimer();
+// Draw the menu or the world view, and copy it to the window.
+void Draw(vector<Rect> &damage);
 uint32_t TimerFunction(uint32_t interval, void *);
 bool Init(char *argv[]);
 void Free();
@@ -58,24 +87,21 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 	
+	// Parts of the window that the world view repainted on this frame.
+	vector<Rect> damage;
 	while(true)
 	{
 		// The frame timer has to control the time between draw events. If the
 		// timer restarted as soon as it elapsed, when the game has been idle
 		// waiting for input it will jump through two frames immediately as soon
 		// as input is available.
-		int x, y;
-		SDL_GetMouseState(&x, &y);
-		Point hover(x, y);
-		
-		if(menu)
-			menu->Draw(screen, hover, world);
-		else
-			world.Draw(screen, hover);
-		SDL_UpdateWindowSurface(window);
+		Draw(damage);
 		
 		if(!HandleEvents())
 			break;
+#ifdef WHIMSY_STATS
+		Stats::EndFrame();
+#endif
 	}
 	
 	world.Save();
@@ -99,9 +125,13 @@ bool HandleEvents()
 		// CPU usage when the game is "idle."
 		SDL_Event event;
 		if(!mustRedraw)
+		{
+			UpdateTimer();
 			SDL_WaitEvent(&event);
+		}
 		else if(!SDL_PollEvent(&event))
 			return true;
+		STATS_TIMER(EVENTS);
 		
 		// Regardless of what UI layer is active, check quit and timer events:
 		if(event.type == SDL_QUIT || (event.type == SDL_KEYDOWN
@@ -113,6 +143,7 @@ bool HandleEvents()
 			{
 				mustRedraw = true;
 				screen = SDL_GetWindowSurface(window);
+				world.Invalidate();
 				if(!fullscreen)
 					windowSize = Point(screen->w, screen->h);
 			}
@@ -127,15 +158,41 @@ bool HandleEvents()
 				// invalidated but no WINDOWEVENT_RESIZED is produced.
 				mustRedraw = true;
 				screen = SDL_GetWindowSurface(window);
+				world.Invalidate();
 			}
 		}
+#ifdef WHIMSY_STATS
+		else if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3)
+		{
+			// Show or hide the frame statistics. Hiding them uncovers part of
+			// the world view, so it must be repainted.
+			Stats::Toggle();
+			world.Invalidate();
+			mustRedraw = true;
+		}
+#endif
 		else if(event.type == SDL_USEREVENT)
 		{
-			Sprite::Step();
+			// Only redraw if something visible changed. The sprites keep
+			// animating even if the world is paused.
+			uint32_t now = SDL_GetTicks();
+			int frames = animation.Advance(now);
+			for(int i = 0; i < frames; ++i)
+				Sprite::Step();
+			
 			// Don't move the avatar if the menu is open.
-			if(!menu)
-				world.Step();
-			mustRedraw = true;
+			if(menu)
+			{
+				simulation.Reset(now);
+				mustRedraw |= (frames && menu->IsAnimated());
+			}
+			else
+			{
+				for(int i = simulation.Advance(now); i > 0; --i)
+					mustRedraw |= world.Step();
+				mustRedraw |= world.Interpolate(simulation.Fraction());
+				mustRedraw |= (frames && world.IsAnimated());
+			}
 		}
 		else if(menu)
 		{
@@ -181,6 +238,72 @@ bool HandleEvents()
 
 
 
+// Start the frame timer if anything may change from one frame to the next,
+// and stop it if not, so that the game uses no CPU while it is idle.
+void UpdateTimer()
+{
+	// It's conceivable that certain games might not define a frame timer - for
+	// example, a game entirely driven by clicking on interaction icons, where
+	// the avatar does not actually move.
+	if(World::FrameRate() <= 0)
+		return;
+	
+	bool isAnimated = (menu ? menu->IsAnimated() : world.IsMoving() || world.IsAnimated());
+	if(isAnimated && !frameTimer)
+	{
+		// Don't try to catch up on the time when the timer was stopped.
+		uint32_t now = SDL_GetTicks();
+		simulation.Reset(now);
+		animation.Reset(now);
+		frameTimer = SDL_AddTimer(1000 / refreshRate, TimerFunction, nullptr);
+	}
+	else if(!isAnimated && frameTimer)
+	{
+		SDL_RemoveTimer(frameTimer);
+		frameTimer = 0;
+	}
+}
+
+
+
+// Draw the menu or the world view, and copy it to the window.
+void Draw(vector<Rect> &damage)
+{
+	Trace::Span span("frame");
+	
+	int x, y;
+	SDL_GetMouseState(&x, &y);
+	Point hover(x, y);
+	
+	Compositor::Begin(screen);
+	if(menu)
+	{
+		menu->Draw(screen, hover, world);
+		Compositor::End();
+		SDL_UpdateWindowSurface(window);
+		// The menu covers the whole window, so once it closes the world
+		// view must be repainted from scratch.
+		world.Invalidate();
+	}
+	else
+	{
+		// Only copy the repainted parts of the window to the display.
+		// Rect adds no data members, so a Rect array is an SDL_Rect array.
+		world.Draw(screen, hover, damage);
+#ifdef WHIMSY_STATS
+		// The overlay is opaque, so it does not need the world to be
+		// repainted under it.
+		if(Stats::IsVisible())
+			damage.push_back(Stats::Draw(screen));
+#endif
+		Compositor::End();
+		if(!damage.empty())
+			SDL_UpdateWindowSurfaceRects(window, damage.data(), damage.size());
+	}
+}
+
+
+
 uint32_t TimerFunction(uint32_t interval, void *)
 {
 	SDL_Event event;
@@ -194,7 +317,21 @@ uint32_t TimerFunction(uint32_t interval, void *)
 
 bool Init(char *argv[])
 {
-	string dataPath = argv[1] ? argv[1] : "data.txt";
+	// The command line may give the path to the data file, and a file to write
+	// a trace of where the engine spends its time to. The trace file can also
+	// be given by the WHIMSY_TRACE environment variable.
+	string dataPath = "data.txt";
+	const char *tracePath = getenv("WHIMSY_TRACE");
+	for(char **it = argv + 1; *it; ++it)
+	{
+		if(!strcmp(*it, "--trace") && it[1])
+			tracePath = *++it;
+		else
+			dataPath = *it;
+	}
+	if(tracePath && *tracePath && !Trace::Open(tracePath))
+		cerr << "Unable to open " << tracePath << endl;
+	
 	// Convert backward slashes to forward slashes, if on windows.
 #ifdef _WIN32
 	for(char &c : dataPath)
@@ -203,6 +340,9 @@ bool Init(char *argv[])
 #endif
 	string directory = dataPath.substr(0, dataPath.rfind('/') + 1);
 	Font::SetDirectory(directory + "fonts/");
+	// If the game has been packed into a bundle, the data files, images, and
+	// kerning are all loaded from that instead.
+	Bundle::Open(dataPath);
 	
 	// Load the data file, and read the first line to get the game title.
 	Data data(dataPath);
@@ -231,6 +371,12 @@ bool Init(char *argv[])
 		cerr << "Unable to initialize SDL." << endl;
 		return false;
 	}
+	// Redraw as often as the display refreshes, if that is known.
+	SDL_DisplayMode mode;
+	if(!SDL_GetWindowDisplayMode(window, &mode) && mode.refresh_rate > 0)
+		refreshRate = mode.refresh_rate;
+	simulation = Clock(World::FrameRate());
+	animation = Clock(World::AnimationRate());
 	
 	// Load all the game data.
 	World::Load(data);
@@ -240,6 +386,26 @@ bool Init(char *argv[])
 		cerr << "Unable to load the font." << endl;
 		return false;
 	}
+	// Now that the window exists, convert all the images to its pixel format.
+	// The compositor must be started first, because it affects how the images
+	// are converted.
+	Compositor::SetThreads(compositorThreads);
+	Sprite::Prepare(screen->format);
+	Font::Prepare(screen->format);
+	Font::SetCacheSize(static_cast<size_t>(textCache) << 10);
+	// The game does not change rooms often enough to make caching their
+	// ground sprites a waste of time.
+	Room::SetGroundCache(true);
+#ifdef WHIMSY_STATS
+	// The statistics log is written beside the saved game.
+	if(!statsLog.empty())
+	{
+		const string &savePath = World::SavePath();
+		string logPath = savePath.substr(0, savePath.rfind('.')) + "-stats." + statsLog;
+		if(!Stats::OpenLog(logPath))
+			cerr << "Unable to open " << logPath << endl;
+	}
+#endif
 	// Attempt to load a saved game.
 	world.Init();
 	// Always show the menu on startup. If there is no "main" menu defined, go
@@ -252,12 +418,6 @@ bool Init(char *argv[])
 		return false;
 	}
 	
-	// Start the animation timer. It's conceivable that certain games might not
-	// define a frame timer - for example, a game entirely driven by clicking on
-	// interaction icons, where the avatar does not actually move.
-	if(World::FrameRate() > 0)
-		frameTimer = SDL_AddTimer(1000 / World::FrameRate(), TimerFunction, nullptr);
-	
 	// Report success.
 	return true;
 }
@@ -269,6 +429,11 @@ void Free()
 	// Stop the frame timer.
 	if(frameTimer)
 		SDL_RemoveTimer(frameTimer);
+	// Stop the compositor threads.
+	Compositor::SetThreads(0);
+	// Finish writing the statistics log and the trace, if any.
+	Stats::CloseLog();
+	Trace::Close();
 	if(window)
 	{
 		// Free the sprites.
@@ -281,6 +446,8 @@ void Free()
 		SDL_DestroyWindow(window);
 		SDL_Quit();
 	}
+	// The images from the bundle, if any, have all been freed.
+	Bundle::Close();
 }
 
 
@@ -300,10 +467,16 @@ void ReadPreferences()
 	
 	for(Data data(preferencesPath); data; data.Next())
 	{
-		if(data.Tag() == "window" && data.Size() >= 2)
+		if(data.Key() == Data::WINDOW && data.Size() >= 2)
 			windowSize = data[1];
-		else if(data.Tag() == "fullscreen")
+		else if(data.Key() == Data::FULLSCREEN)
 			fullscreen = true;
+		else if(data.Key() == Data::COMPOSITOR && data.Size() >= 2)
+			compositorThreads = max(0, static_cast<int>(data[1]));
+		else if(data.Key() == Data::CACHE && data.Size() >= 2)
+			textCache = max(0, static_cast<int>(data[1]));
+		else if(data.Key() == Data::STATS && data.Size() >= 2 && (data.Value(1) == "csv" || data.Value(1) == "json"))
+			statsLog = data.Value(1);
 	}
 }
 
@@ -315,4 +488,10 @@ void SavePreferences()
 	out << "window " << windowSize.X() << "," << windowSize.Y() << '\n';
 	if(fullscreen)
 		out << "fullscreen" << '\n';
+	if(compositorThreads)
+		out << "compositor " << compositorThreads << '\n';
+	if(textCache != DEFAULT_TEXT_CACHE)
+		out << "cache " << textCache << '\n';
+	if(!statsLog.empty())
+		out << "stats " << statsLog << '\n';
 }